@@ -0,0 +1,30 @@
+#ifndef Atan2Benchmark_h
+
+#define Atan2Benchmark_h
+
+#ifdef ATAN2_BENCHMARK
+
+#include <Arduino.h>
+#include "credentials.h"
+
+#ifndef MQTT_ATAN2_BENCHMARK_TOPIC
+#define MQTT_ATAN2_BENCHMARK_TOPIC "duplocar/atan2/benchmark"
+#endif
+
+#define ATAN2_BENCHMARK_SAMPLES 500 // headings timed per run
+#define ATAN2_BENCHMARK_RUNS 4
+
+extern void Log(const String &payload);
+extern void Log(const char *payload);
+extern void Log(const char *topic, const char *payload);
+extern void Log(String topic, String payload);
+
+/*
+   CPU cycles per heading through fastAtan2Tenths against the float atan2
+   QMC5883L used before, on the car. The accuracy half is tools/atan2_bench.
+*/
+void atan2Benchmark();
+
+#endif
+
+#endif
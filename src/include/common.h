@@ -12,6 +12,24 @@
 
 extern PubSubClient MQTTClient;
 
+// what the car can do with the hardware that answered at boot, or since
+#define CAPABILITY_LASER 0x01    // without it speed is capped
+#define CAPABILITY_COMPASS 0x02  // without it there are no heading features
+#define CAPABILITY_NUNCHUCK 0x04 // without it only MQTT drives
+#define CAPABILITY_MOTORS 0x08
+
+// how often sensors that are missing are looked for again
+#ifndef SENSOR_RETRY_MS
+#define SENSOR_RETRY_MS 5000
+#endif
+
+// main loop period, the heading hold steps at the same rate
+#ifndef LOOP_PERIOD_MS
+#define LOOP_PERIOD_MS 50
+#endif
+
+extern uint8_t capabilities;
+
 void setupWifi();
 void setupOTA();
 void Log(const String &payload);
@@ -4,24 +4,84 @@
 
 #include <Arduino.h>
 #include "credentials.h"
-#include <MedianFilter.h> // https://github.com/daPhoosa/MedianFilter
+#include <CircularMedianFilter.h>
 #include "QMC5883L.h"     // https://github.com/dthain/QMC5883L
+#include "yawRate.h"
+
+// GPIO wired to the QMC5883L DRDY pin, define to read the compass only
+// when it has signalled a new sample
+// #define COMPASS_DRDY_PIN D6
+
+// with no DRDY edge for this long, 3 samples at 100Hz, the sensor is read anyway
+#define COMPASS_DRDY_TIMEOUT_US 30000
+
+// no new sample for this long, 50 samples at 100Hz, and the compass counts as gone
+#define COMPASS_LOST_US 500000
+
+// calibration kept in flash through the EEPROM emulation
+#define COMPASS_CALIBRATION_ADDRESS 0
+#define COMPASS_CALIBRATION_VERSION 2
+#define COMPASS_CALIBRATION_MIN_RANGE 100 // narrower than this on x or y isn't worth keeping
+
+// the calibration keeps widening while driving, save it at most this often
+#ifndef COMPASS_CALIBRATION_SAVE_MS
+#define COMPASS_CALIBRATION_SAVE_MS 60000
+#endif
+
+// and only once it has moved this far from the saved one, the ellipse is
+// refitted all the time and hardly ever comes out the same twice
+#define COMPASS_CALIBRATION_SAVE_COUNTS 30 // a bound or the ellipse centre, raw counts
+#define COMPASS_CALIBRATION_SAVE_PERCENT 2 // an ellipse matrix entry, of the largest one
+
+#ifndef MQTT_COMPASS_STATS_TOPIC
+#define MQTT_COMPASS_STATS_TOPIC "duplocar/compass/stats"
+#endif
 
 extern void Log(const String &payload);
 extern void Log(const char *payload);
 extern void Log(const char *topic, const char *payload);
 extern void Log(String topic, String payload);
 
+struct CompassCalibration
+{
+  uint8_t version;
+  int16_t xlow, xhigh;
+  int16_t ylow, yhigh;
+  uint8_t hasEllipse;
+  int16_t x0, y0, m[4]; // EllipseCalibration offset and Q12 matrix
+  uint8_t checksum;
+};
+
 class Compass
 {
 public:
   Compass();
   void Begin();
+  void reinit();
+  void recalibrate();
+  void save();
   int Loop();
+  unsigned long getTimestamp();
+  bool isLost();
+  long getYawRate();
+  bool yawRateReady();
 
 private:
   QMC5883L sensor;
-  MedianFilter medianCompassHeadings;
+  CircularMedianFilter<15> medianCompassHeadings; // wraps at north, seeded by the first heading
+  YawRate yawRate; // from the raw headings, the median lags too much
+  int heading;
+  unsigned long headingTimestamp; // micros() of the sample behind heading
+  uint32_t samplesSinceStats;
+  uint32_t overruns;  // reads that found samples had been missed (DOR)
+  uint32_t overflows; // samples with the field out of range (OVL)
+  uint32_t drdyTimeouts; // reads made because no DRDY edge came
+  unsigned long statsSince;
+  CompassCalibration saved;
+  unsigned long savedAt;
+  void publishStats();
+  bool loadCalibration();
+  void saveCalibration(bool force);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef HeadingHold_h
+
+#define HeadingHold_h
+
+#include <stdint.h>
+
+// control period, one PI step per period with a heading the compass read
+// since the last step
+#ifndef HEADING_HOLD_PERIOD_MS
+#define HEADING_HOLD_PERIOD_MS 50 // as LOOP_PERIOD_MS
+#endif
+
+// gains in sixteenths of duty: per degree of error, and per degree second
+// of accumulated error. negate both if the compass is mounted upside down
+#ifndef HEADING_HOLD_KP
+#define HEADING_HOLD_KP 8
+#endif
+#ifndef HEADING_HOLD_KI
+#define HEADING_HOLD_KI 2
+#endif
+
+#define HEADING_HOLD_MAX_TRIM 10 // duty either way
+
+#define HEADING_HOLD_OFF 0
+#define HEADING_HOLD_NORTH 1
+#define HEADING_HOLD_SOUTH 2
+
+struct HeadingHoldStats
+{
+  uint32_t steps;     // PI steps run
+  uint32_t missed;    // periods without a step, called too late or no new heading
+  uint32_t errorSum;  // sum of |error| over the steps, degrees
+  int errorMax;       // degrees
+  int trim;           // last trim
+};
+
+/*
+   Holds the heading latched when driving straight starts with an integer PI
+   controller, giving a duty trim for left and right. hold() latches and
+   releases the heading as the driving direction changes, step() is the
+   controller's own slot: called as often as the caller likes, it runs one
+   step with a fixed dt per HEADING_HOLD_PERIOD_MS, on a fixed grid. Periods
+   it was called too late for are dropped rather than replayed with a heading
+   that is older than they are, and a heading the last step already used
+   isn't stepped on again. Has no Arduino dependencies so the host tools and
+   tests can use it.
+*/
+class HeadingHold
+{
+public:
+  HeadingHold();
+  void hold(uint8_t direction, int heading, unsigned long nowMillis);
+  bool step(int heading, unsigned long headingTimestamp, unsigned long nowMillis);
+  void stop();
+  uint8_t getDirection();
+  int getTarget();
+  int getTrim();
+  HeadingHoldStats takeStats();
+
+private:
+  uint8_t direction;
+  int target;
+  int32_t integral; // degree milliseconds
+  int trim;
+  unsigned long nextStep;
+  unsigned long steppedTimestamp; // of the heading the last step used
+  HeadingHoldStats stats;
+  void run(int heading);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef I2CBus_h
+
+#define I2CBus_h
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <functional>
+#include "credentials.h"
+
+#ifndef MQTT_I2C_TOPIC
+#define MQTT_I2C_TOPIC "duplocar/i2c"
+#endif
+
+// addresses of everything we expect to find on the bus
+#define I2C_ADDRESS_LEFT_MOTORS 0x09
+#define I2C_ADDRESS_RIGHT_MOTORS 0x30
+#define I2C_ADDRESS_COMPASS 0x0D
+#define I2C_ADDRESS_LASER 0x29
+#define I2C_ADDRESS_NUNCHUCK 0x52
+
+// bus speed profiles, pick one with -D I2C_BUS_PROFILE=... in platformio.ini
+#define I2C_PROFILE_STANDARD 0  // 100kHz
+#define I2C_PROFILE_FAST 1      // 400kHz
+#define I2C_PROFILE_VALIDATED 2 // highest clock every attached device answers correctly at
+
+#ifndef I2C_BUS_PROFILE
+#define I2C_BUS_PROFILE I2C_PROFILE_STANDARD
+#endif
+
+#define I2C_CLOCK_STANDARD 100000
+#define I2C_CLOCK_FAST 400000
+
+// consecutive idle checks that must find a line held low before we recover
+#define I2C_STUCK_CHECKS 3
+#define I2C_MAX_RECOVERY_HANDLERS 4
+
+extern void Log(const String &payload);
+extern void Log(const char *payload);
+extern void Log(const char *topic, const char *payload);
+extern void Log(String topic, String payload);
+
+struct I2CDevice
+{
+  uint8_t address;
+  const char *name;
+  uint32_t maxClock; // highest validated clock, 0 if never validated
+};
+
+class I2CBus
+{
+public:
+  I2CBus();
+  void Begin();
+  void setClock(uint32_t clock);
+  uint32_t getClock();
+  void Benchmark();
+  bool Loop();
+  bool recover();
+  void onRecovery(std::function<void()> handler);
+  uint8_t discover();
+  bool present(uint8_t address);
+  bool probe(uint8_t address);
+  void scan();
+
+private:
+  uint32_t clock;
+  I2CDevice devices[5];
+  uint8_t deviceCount;
+  uint8_t presence; // bit per entry in devices, set when it acknowledged discover()
+  std::function<void()> recoveryHandlers[I2C_MAX_RECOVERY_HANDLERS];
+  uint8_t recoveryHandlerCount;
+  uint8_t stuckChecks;
+  uint32_t recoveries;
+  uint32_t recoveryMicros;
+  bool linesReleased();
+  uint32_t validate();
+  bool validateDevice(const I2CDevice &device);
+  bool transaction(uint8_t address);
+};
+
+#endif
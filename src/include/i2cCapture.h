@@ -0,0 +1,63 @@
+#ifndef I2CCapture_h
+
+#define I2CCapture_h
+
+#ifdef I2C_CAPTURE
+
+#include <Arduino.h>
+#include "credentials.h"
+
+#ifndef MQTT_I2C_CAPTURE_TOPIC
+#define MQTT_I2C_CAPTURE_TOPIC "duplocar/i2c/capture"
+#endif
+
+#ifndef I2C_CAPTURE_SIZE
+#define I2C_CAPTURE_SIZE 4096 // bytes of ring buffer
+#endif
+
+#define I2C_CAPTURE_MAX_DATA 16 // bytes kept per transaction, the length is always kept
+#define I2C_CAPTURE_DUMP_CHUNK 32 // bytes per dumped line, sent as hex, fits the PubSubClient packet size
+
+extern void Log(const String &payload);
+extern void Log(const char *payload);
+extern void Log(const char *topic, const char *payload);
+extern void Log(String topic, String payload);
+
+/*
+   Every transaction through the ESP8266 twi layer, recorded by wrapping
+   twi_writeTo and twi_readFrom at link time. One record is
+
+     varint  microseconds since the previous record
+     uint8   address << 1 | 1 for a read
+     uint8   twi result, 0 is success
+     uint8   bytes transferred
+     uint8[] the first I2C_CAPTURE_MAX_DATA of those bytes
+
+   Oldest records are dropped whole when the ring is full.
+*/
+class I2CCapture
+{
+public:
+  I2CCapture();
+  void record(uint8_t address, bool read, const uint8_t *data, unsigned int len, uint8_t result, unsigned long started);
+  void dump();
+  void clear();
+
+private:
+  uint8_t ring[I2C_CAPTURE_SIZE];
+  uint16_t head;   // next byte written
+  uint16_t tail;   // first byte of the oldest record
+  uint16_t used;
+  uint32_t records;
+  uint32_t dropped;
+  unsigned long lastMicros;
+  void put(uint8_t value);
+  uint8_t at(uint16_t offset);
+  void dropOldest();
+};
+
+extern I2CCapture i2cCapture;
+
+#endif
+
+#endif
@@ -5,22 +5,90 @@
 #include <Arduino.h>
 #include <limits.h>
 #include "Adafruit_VL53L0X.h"
+#include "HampelFilter.h"
 #include "credentials.h"
 
+// inter-measurement period of continuous ranging, 0 ranges back to back
+#ifndef LASER_PERIOD_MS
+#define LASER_PERIOD_MS 0
+#endif
+
+// GPIO wired to the VL53L0X GPIO1 pin, define to collect samples on its
+// new sample interrupt instead of polling the interrupt status register
+// #define LASER_INTERRUPT_PIN D5
+
+// with no new sample interrupt for this many timing budgets the sensor is
+// polled anyway, GPIO1 may be stuck low and never fall again
+#define LASER_INTERRUPT_TIMEOUT_BUDGETS 3
+
+// no new sample for this many timing budgets and the laser counts as gone
+#define LASER_LOST_BUDGETS 10
+
+#ifndef MQTT_LASER_STATS_TOPIC
+#define MQTT_LASER_STATS_TOPIC "duplocar/laser/stats"
+#endif
+
+// timing budget profiles, picked from the commanded duty and range
+#define LASER_PROFILE_HIGH_SPEED 0 // 20ms budget, near something or braking
+#define LASER_PROFILE_DEFAULT 1    // 33ms budget
+#define LASER_PROFILE_ACCURATE 2   // 200ms budget, crawling or parked in the open
+
+#define LASER_CRAWL_DUTY 16       // at or below this we are crawling
+#define LASER_NEAR_MM 600         // closer than this is high speed, whatever the duty
+#define LASER_PROFILE_DWELL_MS 500 // minimum time in a profile, except to go high speed
+
+// outlier rejection on in-range samples, a sample further away than the
+// threshold (tenths of a scaled MAD) above the window median is replaced
+// by it. closer samples always pass, they may be something to brake for.
+// the window starts again after an out of range sample, a profile switch
+// or LASER_HAMPEL_MAX_GAP_BUDGETS budgets without a sample
+#ifndef LASER_HAMPEL_WINDOW
+#define LASER_HAMPEL_WINDOW 7
+#endif
+#ifndef LASER_HAMPEL_THRESHOLD
+#define LASER_HAMPEL_THRESHOLD 30
+#endif
+#ifndef LASER_HAMPEL_MIN_MAD
+#define LASER_HAMPEL_MIN_MAD 10 // mm, about the sensor's noise
+#endif
+#define LASER_HAMPEL_MAX_GAP_BUDGETS 3
+
 extern void Log(const String &payload);
 extern void Log(const char *payload);
 extern void Log(const char *topic, const char *payload);
 extern void Log(String topic, String payload);
 
+struct LaserSample
+{
+  int rangeMilliMeter;     // INT_MAX when out of range
+  unsigned long timestamp; // micros() when the sample was collected
+  uint32_t sequence;       // goes up by one for every new sample
+};
+
 class Laser
 {
 public:
   Laser();
-  void Begin();
+  bool Begin();
   int Loop();
+  LaserSample getSample();
+  bool isLost();
+  void adapt(int commandedDuty, int rangeMilliMeter, bool braking);
 
 private:
   Adafruit_VL53L0X lox;
+  HampelFilter<int, LASER_HAMPEL_WINDOW> outliers;
+  LaserSample sample;
+  unsigned long filteredAt; // micros() of the last sample through the filter
+  uint8_t profile;
+  unsigned long profileSince;
+  uint32_t profileSwitches;
+  uint32_t interruptTimeouts; // polls made because no interrupt came
+  uint32_t samplesSinceStats;
+  unsigned long statsSince;
+  void setProfile(uint8_t newProfile);
+  unsigned long budgetMicros();
+  void publishStats();
 };
 
 #endif
@@ -0,0 +1,18 @@
+#ifndef LeastSquares_h
+
+#define LeastSquares_h
+
+#include <stdint.h>
+
+/*
+   Least squares slope of timestamped samples held in a ring buffer, per
+   second, in integer maths. Shared by RangeRate and YawRate. Has no Arduino
+   dependencies so the host tools can use it.
+
+   values and timestamps hold window entries, the count newest samples end
+   just before next. 0 with fewer than two samples or when they all share a
+   timestamp.
+*/
+long leastSquaresSlope(const long *values, const unsigned long *timestamps, uint8_t window, uint8_t next, uint8_t count);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef MedianBenchmark_h
+
+#define MedianBenchmark_h
+
+#ifdef MEDIAN_BENCHMARK
+
+#include <Arduino.h>
+#include "credentials.h"
+
+#ifndef MQTT_MEDIAN_BENCHMARK_TOPIC
+#define MQTT_MEDIAN_BENCHMARK_TOPIC "duplocar/median/benchmark"
+#endif
+
+#define MEDIAN_BENCHMARK_CHANNELS 6   // laser, heading, compass x/y/z and a nunchuck axis
+#define MEDIAN_BENCHMARK_BATCHES 2000 // batches timed per window
+
+extern void Log(const String &payload);
+extern void Log(const char *payload);
+extern void Log(const char *topic, const char *payload);
+extern void Log(String topic, String payload);
+
+/*
+   Times a MedianFilterBank against the same number of separate
+   MedianFilters on the car, the device half of tools/median_bench.
+*/
+void medianBenchmark();
+
+#endif
+
+#endif
@@ -6,6 +6,44 @@
 #include <Arduino.h>
 #include "credentials.h"
 #include "LOLIN_I2C_MOTOR.h"
+#include "i2cBus.h"
+#include "laser.h"
+#include "rangeRate.h"
+#include "headingHold.h"
+
+// without the laser there is no distance to slow down for
+#ifndef NO_LASER_MAX_DUTY
+#define NO_LASER_MAX_DUTY 25
+#endif
+
+// getInfo attempts per shield before giving up on it at boot
+#define MOTORS_BEGIN_TRIES 20
+
+// back to back non waiting writes to one shield are spaced by this much,
+// so its firmware has taken the last command before the next arrives
+#ifndef MOTORS_MIN_WRITE_GAP_US
+#define MOTORS_MIN_WRITE_GAP_US 1000
+#endif
+
+// unchanged commands go out again this often, in case a write was lost
+// or a shield reset and forgot them
+#define MOTORS_REFRESH_MS 1000
+
+// turning on the spot for this long without the compass seeing the car
+// turn means it is stuck, the motors are stopped until the command changes
+#ifndef STALL_AFTER_MS
+#define STALL_AFTER_MS 600
+#endif
+#define STALL_MIN_YAW_RATE 15 // degrees per second
+
+// brake when the laser says we will hit something sooner than this
+#ifndef TTC_BRAKE_MS
+#define TTC_BRAKE_MS 400
+#endif
+
+#ifndef MQTT_HEADING_HOLD_TOPIC
+#define MQTT_HEADING_HOLD_TOPIC "duplocar/heading/hold"
+#endif
 
 extern void Log(const String &payload);
 extern void Log(const char *payload);
@@ -19,18 +57,53 @@ struct MotorXY
   bool fromMQTT;
 };
 
+// what a shield was last sent, so an unchanged command isn't sent again
+struct ShieldSent
+{
+  int duty;                // -1 when unknown
+  int status;              // -1 when unknown
+  unsigned long writtenAt; // micros
+};
+
 class Motors
 {
 public:
   Motors();
-  void Begin();
-  void setMapped(int mapx, int mapy, int laserRangeMilliMeter); //, int medianCompassHeading);
+  bool Begin();
+  void reinit();
+  void setDutyCap(int cap);
+  int getCommandedDuty();
+  bool isBraking();
+  void checkCollision(const LaserSample &sample);
+  void checkStall(long yawRate, bool yawRateReady);
+  void setMapped(int mapx, int mapy, int laserRangeMilliMeter, int medianCompassHeading);
+  void holdHeading(int medianCompassHeading, unsigned long headingTimestamp);
 
 private:
   LOLIN_I2C_MOTOR leftMotors;  //using customize I2C address
   LOLIN_I2C_MOTOR rightMotors; //I2C address 0x30
- //bool autoCorrectWithCompass = false;
-  //int compassHeadingWhenStartedLinear = -1;
+  int commandedDuty;
+  int dutyCap;
+  bool forward;
+  bool braking;
+  uint32_t lastLaserSequence;
+  RangeRate rangeRate;
+  HeadingHold headingHold;
+  int straightDuty; // duty the heading hold trims, 0 when not driving straight
+  int trimSent;     // trim in the duties last sent
+  unsigned long holdStatsSince;
+  int rotating; // -1 west, 1 east, 0 not turning on the spot
+  bool stalled;
+  unsigned long rotatingSince;
+  ShieldSent leftSent;
+  ShieldSent rightSent;
+  unsigned long refreshedAt;
+  void sendDuty(LOLIN_I2C_MOTOR &shield, ShieldSent &sent, int duty);
+  void sendStatus(LOLIN_I2C_MOTOR &shield, ShieldSent &sent, int status);
+  void forgetSent();
+  void brake();
+  void driveStraight();
+  void publishHoldStats();
 };
 
 #endif
\ No newline at end of file
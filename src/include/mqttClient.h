@@ -26,11 +26,13 @@ public:
     void publishMQTTmessage(String topic, String msg);
     void reconnect();
     MotorXY Loop();
+    String takeCommand();
 
 private:
     void callback(char *topic, byte *payload, unsigned int length);
     size_t capacity;
     volatile MotorXY motorXY;
+    String command;
     WiFiClient espClient;
 };
 
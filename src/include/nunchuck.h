@@ -5,32 +5,32 @@
 #include <Arduino.h>
 #include "credentials.h"
 #include "motors.h"
+#include "nunchuckReport.h"
 
 extern void Log(const String &payload);
 extern void Log(const char *payload);
 extern void Log(const char *topic, const char *payload);
 extern void Log(String topic, String payload);
 
+// reads in a row that come up short before the nunchuck counts as gone
+#define NUNCHUCK_LOST_READS 10
+
 class Nunchuck
 {
 public:
   Nunchuck();
   void nunchuck_init();
   MotorXY Loop();
+  NunchuckReport getReport();
+  bool isLost();
 
 private:
-  byte accx, accy, zbut, cbut, joyx, joyy;
+  NunchuckReport report; // the last good report
+  uint8_t failedReads;   // in a row
   void nunchuck_send_request();
   char nunchuk_decode_byte(char x);
   int nunchuck_get_data();
   void nunchuck_print_data();
-  int nunchuck_zbutton();
-  int nunchuck_cbutton();
-  int nunchuck_joyx();
-  int nunchuck_joyy();
-  int nunchuck_accelx();
-  int nunchuck_accely();
-  int nunchuck_accelz();
   uint8_t nunchuck_buf[6]; // array to store nunchuck data,
 };
 
@@ -0,0 +1,39 @@
+#ifndef NunchuckReport_h
+
+#define NunchuckReport_h
+
+#include <stdint.h>
+
+// what the joystick reads at rest
+#define NUNCHUCK_JOY_CENTRE 128
+
+// a level accelerometer axis, 10 bits
+#define NUNCHUCK_ACCEL_CENTRE 512
+
+/*
+   One nunchuck report, unpacked from the 6 bytes it sends once they have
+   been through nunchuk_decode_byte
+
+     0     joystick x
+     1     joystick y
+     2..4  accelerometer x, y, z, high 8 bits
+     5     bit 0 z button, bit 1 c button, both 0 when pressed, then the
+           low 2 bits of accelerometer x, y and z
+
+   Has no Arduino dependencies so the host tools can use it.
+*/
+struct NunchuckReport
+{
+  uint8_t joyX;
+  uint8_t joyY;
+  uint32_t accelX : 10;
+  uint32_t accelY : 10;
+  uint32_t accelZ : 10;
+  uint32_t zButton : 1; // 1 when pressed
+  uint32_t cButton : 1;
+};
+
+NunchuckReport decodeNunchuckReport(const uint8_t *buf);
+NunchuckReport idleNunchuckReport(); // centred, level and nothing pressed
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RangeRate_h
+
+#define RangeRate_h
+
+#include <stdint.h>
+#include <limits.h>
+
+// samples the closing speed is fitted over
+#define RANGE_RATE_WINDOW 4
+
+// a gap longer than this between samples starts the estimate again, over
+// twice the longest timing budget
+#define RANGE_RATE_MAX_GAP_US 500000UL
+
+// ttcMillis() when we are not closing on anything
+#define RANGE_RATE_NO_COLLISION LONG_MAX
+
+/*
+   Closing speed and time to collision from timestamped range samples, a
+   least squares slope (leastSquares.h) over the last RANGE_RATE_WINDOW
+   samples. Has no Arduino dependencies so the host tools can use it.
+*/
+class RangeRate
+{
+public:
+  RangeRate();
+  void add(int rangeMilliMeter, unsigned long timestampMicros);
+  void reset();
+  long closingSpeed(); // mm/s, positive when the range is shrinking
+  long ttcMillis();    // ms until the range reaches zero at the current closing speed
+
+private:
+  long ranges[RANGE_RATE_WINDOW];
+  unsigned long timestamps[RANGE_RATE_WINDOW];
+  uint8_t next;
+  uint8_t count;
+};
+
+#endif
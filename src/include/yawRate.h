@@ -0,0 +1,36 @@
+#ifndef YawRate_h
+
+#define YawRate_h
+
+#include <stdint.h>
+
+// samples the yaw rate is fitted over
+#define YAW_RATE_WINDOW 5
+
+// a gap longer than this between samples starts the estimate again
+#define YAW_RATE_MAX_GAP_US 500000UL
+
+/*
+   Yaw rate from timestamped compass headings, a least squares slope
+   (leastSquares.h) over the last YAW_RATE_WINDOW samples. Headings are
+   unwrapped as they arrive so turning through north is a small step, not a
+   jump of 359 degrees. Has no Arduino dependencies so the host tools can
+   use it.
+*/
+class YawRate
+{
+public:
+  YawRate();
+  void add(int heading, unsigned long timestampMicros);
+  void reset();
+  long degreesPerSecond(); // positive turning clockwise
+  bool ready();            // enough samples for a rate
+
+private:
+  long headings[YAW_RATE_WINDOW]; // unwrapped degrees
+  unsigned long timestamps[YAW_RATE_WINDOW];
+  uint8_t next;
+  uint8_t count;
+};
+
+#endif
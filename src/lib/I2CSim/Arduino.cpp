@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include "Arduino.h"
+#include "Wire.h"
+
+#define PINS 17
+
+static uint8_t modes[PINS];
+static uint8_t levels[PINS];
+
+HardwareSerial Serial;
+
+unsigned long millis()
+{
+  return Wire.micros() / 1000;
+}
+
+unsigned long micros()
+{
+  return Wire.micros();
+}
+
+void delay(unsigned long ms)
+{
+  Wire.advance(ms * 1000ULL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  Wire.advance(us);
+}
+
+void yield()
+{
+}
+
+static bool drives(uint8_t mode)
+{
+  return mode == OUTPUT || mode == OUTPUT_OPEN_DRAIN;
+}
+
+// an input lets its I2C line float up, an output drives what was written
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin >= PINS)
+  {
+    return;
+  }
+
+  modes[pin] = mode;
+
+  if (pin == SDA || pin == SCL)
+  {
+    Wire.drive(pin == SDA ? I2CSIM_SDA : I2CSIM_SCL, drives(mode) == false || levels[pin] == HIGH);
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin >= PINS)
+  {
+    return;
+  }
+
+  levels[pin] = value;
+
+  if ((pin == SDA || pin == SCL) && drives(modes[pin]) == true)
+  {
+    Wire.drive(pin == SDA ? I2CSIM_SDA : I2CSIM_SCL, value == HIGH);
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (pin == SDA || pin == SCL)
+  {
+    return Wire.level(pin == SDA ? I2CSIM_SDA : I2CSIM_SCL) == true ? HIGH : LOW;
+  }
+
+  return pin < PINS ? levels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t /* pin */, void (* /* handler */)(void), int /* mode */)
+{
+}
+
+void detachInterrupt(uint8_t /* pin */)
+{
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+String::String(double value, unsigned char decimals)
+{
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  s = buffer;
+}
+
+std::string String::format(long long value, unsigned char base)
+{
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), base == HEX ? "%llx" : "%lld", value);
+  return buffer;
+}
@@ -0,0 +1,113 @@
+/*
+   Arduino.h for the native env - the part of the ESP8266 core the drivers
+   and i2cBus.cpp use, on a host.
+
+   Time is the I2C bus' simulated clock: millis() and micros() read
+   Wire.micros(), delay() and delayMicroseconds() advance it, so a driver
+   that waits 50ms costs nothing to run. SDA and SCL are the simulated bus
+   lines, other pins just remember what was written to them. Interrupts are
+   never raised and Serial goes nowhere.
+ */
+
+#ifndef Arduino_h
+
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+#define OUTPUT_OPEN_DRAIN 0x03
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define DEC 10
+#define HEX 16
+
+// the d1_mini's I2C pins, D2 and D1
+#define SDA 4
+#define SCL 5
+
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define F(s) (s)
+#define digitalPinToInterrupt(p) (p)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::max;
+using std::min;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+class String
+{
+public:
+  String() {}
+  String(const char *s) : s(s != NULL ? s : "") {}
+  String(const std::string &s) : s(s) {}
+  String(char c) : s(1, c) {}
+  String(int value, unsigned char base = DEC) : s(format(value, base)) {}
+  String(unsigned int value, unsigned char base = DEC) : s(format(value, base)) {}
+  String(long value, unsigned char base = DEC) : s(format(value, base)) {}
+  String(unsigned long value, unsigned char base = DEC) : s(format(value, base)) {}
+  String(double value, unsigned char decimals = 2);
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  void reserve(unsigned int size) { s.reserve(size); }
+
+  String &operator+=(const String &other)
+  {
+    s += other.s;
+    return *this;
+  }
+
+  bool operator==(const String &other) const { return s == other.s; }
+  bool operator!=(const String &other) const { return s != other.s; }
+
+  friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+
+private:
+  std::string s;
+  static std::string format(long long value, unsigned char base);
+};
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long) {}
+  template <typename T> size_t print(const T &) { return 0; }
+  template <typename T> size_t println(const T &) { return 0; }
+  size_t println() { return 0; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,650 @@
+#include <string.h>
+#include "I2CSim.h"
+
+/*
+ * Bus
+ */
+
+I2CSimDevice::I2CSimDevice(uint8_t address) : address(address), latencyMicros(0), attached(true), writes(0), reads(0), fault(I2CSIM_FAULT_NONE), faultCount(0)
+{
+}
+
+void I2CSimDevice::injectFault(I2CSimFault newFault, uint32_t transactions)
+{
+  fault = newFault;
+  faultCount = transactions;
+}
+
+// the fault for the transaction in progress, if any
+I2CSimFault I2CSimDevice::takeFault()
+{
+  if (faultCount == 0)
+  {
+    return I2CSIM_FAULT_NONE;
+  }
+
+  faultCount--;
+  return fault;
+}
+
+I2CSimBus::I2CSimBus() : clock(100000), transactions(0), errors(0), sdaHoldClocks(I2CSIM_HOLD_CLOCKS), sclClocks(0), starts(0), stops(0), deviceCount(0), sdaHeld(false), holdClocksLeft(0), sdaDriven(true), sclDriven(true), now(0), txAddress(0), txLength(0), rxLength(0), rxIndex(0)
+{
+}
+
+void I2CSimBus::attach(I2CSimDevice &device)
+{
+  if (deviceCount < I2CSIM_MAX_DEVICES)
+  {
+    devices[deviceCount++] = &device;
+  }
+}
+
+// as twi_init, both lines released
+void I2CSimBus::begin()
+{
+  sdaDriven = true;
+  sclDriven = true;
+  txLength = 0;
+  rxLength = 0;
+  rxIndex = 0;
+}
+
+void I2CSimBus::setClock(uint32_t frequency)
+{
+  clock = frequency;
+}
+
+void I2CSimBus::beginTransmission(uint8_t address)
+{
+  txAddress = address;
+  txLength = 0;
+}
+
+size_t I2CSimBus::write(uint8_t data)
+{
+  if (txLength >= I2CSIM_BUFFER_LENGTH)
+  {
+    return 0;
+  }
+
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+size_t I2CSimBus::write(const uint8_t *data, size_t len)
+{
+  size_t n = 0;
+
+  while (n < len && write(data[n]) == 1)
+  {
+    n++;
+  }
+
+  return n;
+}
+
+// return codes as TwoWire: 0 ok, 2 address nack, 4 other error
+uint8_t I2CSimBus::endTransmission(uint8_t sendStop)
+{
+  I2CSimDevice *device = find(txAddress);
+
+  transactions++;
+  spend(txLength + 1, device, sendStop != 0);
+
+  if (sdaHeld == true)
+  {
+    errors++;
+    return 4;
+  }
+
+  I2CSimFault fault = device != NULL ? device->takeFault() : I2CSIM_FAULT_NONE;
+
+  if (device == NULL || fault == I2CSIM_FAULT_NACK)
+  {
+    errors++;
+    return 2;
+  }
+
+  device->writes++;
+  device->received(txBuffer, txLength, now);
+
+  if (fault == I2CSIM_FAULT_HOLD_SDA)
+  {
+    hold();
+    errors++;
+    return 4;
+  }
+
+  return 0;
+}
+
+uint8_t I2CSimBus::requestFrom(uint8_t address, uint8_t len, uint8_t sendStop)
+{
+  I2CSimDevice *device = find(address);
+
+  if (len > I2CSIM_BUFFER_LENGTH)
+  {
+    len = I2CSIM_BUFFER_LENGTH;
+  }
+
+  transactions++;
+  spend(len + 1, device, sendStop != 0);
+
+  rxLength = 0;
+  rxIndex = 0;
+
+  I2CSimFault fault = device != NULL ? device->takeFault() : I2CSIM_FAULT_NONE;
+
+  if (sdaHeld == true || device == NULL || fault == I2CSIM_FAULT_NACK)
+  {
+    errors++;
+    return 0;
+  }
+
+  if (fault == I2CSIM_FAULT_HOLD_SDA)
+  {
+    hold();
+    errors++;
+    return 0;
+  }
+
+  device->reads++;
+  rxLength = device->requested(rxBuffer, len, now);
+
+  if (fault == I2CSIM_FAULT_SHORT_READ)
+  {
+    rxLength /= 2;
+  }
+
+  if (fault == I2CSIM_FAULT_CORRUPT)
+  {
+    for (uint8_t i = 0; i < rxLength; i++)
+    {
+      rxBuffer[i] = ~rxBuffer[i];
+    }
+  }
+
+  if (rxLength != len)
+  {
+    errors++;
+  }
+
+  return rxLength;
+}
+
+int I2CSimBus::available()
+{
+  return rxLength - rxIndex;
+}
+
+int I2CSimBus::read()
+{
+  if (rxIndex >= rxLength)
+  {
+    return -1;
+  }
+
+  return rxBuffer[rxIndex++];
+}
+
+uint8_t I2CSimBus::status()
+{
+  return sdaHeld == true ? I2CSIM_SDA_HELD_LOW : I2CSIM_OK;
+}
+
+uint64_t I2CSimBus::micros()
+{
+  return now;
+}
+
+void I2CSimBus::advance(uint64_t micros)
+{
+  now += micros;
+}
+
+void I2CSimBus::clockOut()
+{
+  spend(1, NULL);
+  sdaHeld = false;
+}
+
+void I2CSimBus::hold()
+{
+  sdaHeld = true;
+  holdClocksLeft = sdaHoldClocks;
+}
+
+// the held device shifts out a bit on every SCL falling edge and lets go of
+// SDA on the edge after its last one, so SDA never moves while SCL is high
+void I2CSimBus::drive(uint8_t line, bool high)
+{
+  if (line == I2CSIM_SCL)
+  {
+    if (high == true && sclDriven == false)
+    {
+      sclClocks++;
+    }
+
+    if (high == false && sclDriven == true && sdaHeld == true)
+    {
+      if (holdClocksLeft > 0)
+      {
+        holdClocksLeft--;
+      }
+
+      if (holdClocksLeft == 0)
+      {
+        sdaHeld = false;
+      }
+    }
+
+    sclDriven = high;
+    return;
+  }
+
+  bool before = level(I2CSIM_SDA);
+  sdaDriven = high;
+  bool after = level(I2CSIM_SDA);
+
+  if (level(I2CSIM_SCL) == true && before != after)
+  {
+    if (after == true)
+    {
+      stops++;
+    }
+    else
+    {
+      starts++;
+    }
+  }
+}
+
+bool I2CSimBus::level(uint8_t line)
+{
+  if (line == I2CSIM_SCL)
+  {
+    return sclDriven;
+  }
+
+  return sdaDriven == true && sdaHeld == false;
+}
+
+I2CSimDevice *I2CSimBus::find(uint8_t address)
+{
+  for (uint8_t i = 0; i < deviceCount; i++)
+  {
+    if (devices[i]->address == address && devices[i]->attached == true)
+    {
+      return devices[i];
+    }
+  }
+
+  return NULL;
+}
+
+// start, 9 bits per byte with the ack, stop unless the next start repeats
+void I2CSimBus::spend(size_t bytes, I2CSimDevice *device, bool stop)
+{
+  uint64_t bits = (stop == true ? 2 : 1) + 9 * bytes;
+
+  now += (bits * 1000000ULL + clock - 1) / clock;
+
+  if (device != NULL)
+  {
+    now += device->latencyMicros;
+  }
+}
+
+/*
+ * LOLIN I2C motor shield
+ */
+
+// command bytes, as I2C_CMD in LOLIN_I2C_MOTOR.h
+#define LOLIN_GET_SLAVE_STATUS 0x01
+#define LOLIN_CHANGE_STATUS 0x04
+#define LOLIN_CHANGE_FREQ 0x05
+#define LOLIN_CHANGE_DUTY 0x06
+#define LOLIN_PRODUCT_ID 0x02
+#define LOLIN_VERSION 0x01
+
+LolinMotorSim::LolinMotorSim(uint8_t address) : I2CSimDevice(address), commands(0), replyDelayMicros(0), replyReadyAt(0)
+{
+  for (int ch = 0; ch < 2; ch++)
+  {
+    status[ch] = 0;
+    duty[ch] = 0;
+    freq[ch] = 1000;
+  }
+
+  reply[0] = reply[1] = 0;
+  pendingReply[0] = pendingReply[1] = 0;
+}
+
+void LolinMotorSim::received(const uint8_t *data, size_t len, uint64_t now)
+{
+  if (len == 0)
+  {
+    return;
+  }
+
+  // channel 2 is both
+  uint8_t first = len > 1 && data[1] == 1 ? 1 : 0;
+  uint8_t last = len > 1 && data[1] == 0 ? 0 : 1;
+
+  pendingReply[0] = 0;
+  pendingReply[1] = 0;
+
+  switch (data[0])
+  {
+  case LOLIN_GET_SLAVE_STATUS:
+    pendingReply[0] = LOLIN_PRODUCT_ID;
+    pendingReply[1] = LOLIN_VERSION;
+    break;
+
+  case LOLIN_CHANGE_STATUS:
+    if (len < 3)
+    {
+      return;
+    }
+    for (uint8_t ch = first; ch <= last; ch++)
+    {
+      status[ch] = data[2];
+    }
+    break;
+
+  case LOLIN_CHANGE_FREQ:
+    if (len < 5)
+    {
+      return;
+    }
+    for (uint8_t ch = first; ch <= last; ch++)
+    {
+      freq[ch] = data[2] | (data[3] << 8) | ((uint32_t)data[4] << 16);
+    }
+    break;
+
+  case LOLIN_CHANGE_DUTY:
+    if (len < 4)
+    {
+      return;
+    }
+    for (uint8_t ch = first; ch <= last; ch++)
+    {
+      duty[ch] = data[2] | (data[3] << 8);
+    }
+    break;
+  }
+
+  commands++;
+  replyReadyAt = now + replyDelayMicros;
+}
+
+size_t LolinMotorSim::requested(uint8_t *data, size_t len, uint64_t now)
+{
+  if (now >= replyReadyAt)
+  {
+    reply[0] = pendingReply[0];
+    reply[1] = pendingReply[1];
+  }
+
+  size_t n = len < 2 ? len : 2;
+  memcpy(data, reply, n);
+
+  return n;
+}
+
+/*
+ * QMC5883L
+ */
+
+#define QMC_STATUS 6
+#define QMC_CONFIG 9
+#define QMC_CONFIG2 10
+#define QMC_CHIP_ID 13
+#define QMC_STATUS_DRDY 1
+#define QMC_STATUS_DOR 4
+#define QMC_CONFIG2_ROL_PNT 0x40
+#define QMC_CONFIG2_SOFT_RST 0x80
+
+QMC5883LSim::QMC5883LSim(uint8_t address) : I2CSimDevice(address), x(0), y(0), z(0), t(0), pointer(0), nextSampleAt(0)
+{
+  memset(registers, 0, sizeof(registers));
+  registers[QMC_CHIP_ID] = 0xFF;
+}
+
+// output data rate from CONFIG, 10/50/100/200Hz
+uint32_t QMC5883LSim::periodMicros()
+{
+  static const uint32_t periods[] = {100000, 20000, 10000, 5000};
+  return periods[(registers[QMC_CONFIG] >> 2) & 0x03];
+}
+
+// load a new conversion if one is due in continuous mode
+void QMC5883LSim::sample(uint64_t now)
+{
+  if ((registers[QMC_CONFIG] & 0x03) != 0x01 || now < nextSampleAt)
+  {
+    return;
+  }
+
+  uint64_t missed = (now - nextSampleAt) / periodMicros();
+
+  // the previous sample was never read, or whole samples went by unseen
+  if (missed > 0 || (registers[QMC_STATUS] & QMC_STATUS_DRDY))
+  {
+    registers[QMC_STATUS] |= QMC_STATUS_DOR;
+  }
+
+  int16_t values[] = {x, y, z};
+  for (int i = 0; i < 3; i++)
+  {
+    registers[i * 2] = values[i] & 0xFF;
+    registers[i * 2 + 1] = (values[i] >> 8) & 0xFF;
+  }
+  registers[7] = t & 0xFF;
+  registers[8] = (t >> 8) & 0xFF;
+
+  registers[QMC_STATUS] |= QMC_STATUS_DRDY;
+  nextSampleAt += (missed + 1) * periodMicros();
+}
+
+void QMC5883LSim::received(const uint8_t *data, size_t len, uint64_t now)
+{
+  if (len == 0)
+  {
+    return;
+  }
+
+  pointer = data[0];
+
+  for (size_t i = 1; i < len && pointer < sizeof(registers); i++, pointer++)
+  {
+    if (pointer == QMC_CONFIG2 && (data[i] & QMC_CONFIG2_SOFT_RST))
+    {
+      memset(registers, 0, sizeof(registers));
+      registers[QMC_CHIP_ID] = 0xFF;
+      continue;
+    }
+
+    if (pointer < QMC_CONFIG || pointer == QMC_CHIP_ID)
+    {
+      continue; // read only
+    }
+
+    registers[pointer] = data[i];
+
+    if (pointer == QMC_CONFIG)
+    {
+      nextSampleAt = now + periodMicros();
+    }
+  }
+}
+
+// as the chip, reading any data register clears DRDY and DOR there and
+// then, so STATUS read later in the same burst shows them clear
+size_t QMC5883LSim::requested(uint8_t *data, size_t len, uint64_t now)
+{
+  sample(now);
+
+  for (size_t i = 0; i < len; i++)
+  {
+    if (pointer >= sizeof(registers))
+    {
+      pointer = 0;
+    }
+
+    data[i] = registers[pointer];
+
+    if (pointer < QMC_STATUS)
+    {
+      registers[QMC_STATUS] &= ~(QMC_STATUS_DRDY | QMC_STATUS_DOR);
+    }
+
+    pointer++;
+
+    if ((registers[QMC_CONFIG2] & QMC_CONFIG2_ROL_PNT) && pointer > QMC_STATUS)
+    {
+      pointer = 0;
+    }
+  }
+
+  return len;
+}
+
+/*
+ * Wii nunchuck
+ */
+
+NunchuckSim::NunchuckSim(uint8_t address) : I2CSimDevice(address), joyX(128), joyY(128), accelX(512), accelY(512), accelZ(512), zButton(false), cButton(false), initialised(false)
+{
+  encode();
+}
+
+// pack the report as the nunchuck does, then apply the encoding that
+// Nunchuck::nunchuk_decode_byte undoes
+void NunchuckSim::encode()
+{
+  report[0] = joyX;
+  report[1] = joyY;
+  report[2] = accelX >> 2;
+  report[3] = accelY >> 2;
+  report[4] = accelZ >> 2;
+  report[5] = (zButton ? 0 : 0x01) | (cButton ? 0 : 0x02) | ((accelX & 0x03) << 2) | ((accelY & 0x03) << 4) | ((accelZ & 0x03) << 6);
+
+  for (int i = 0; i < 6; i++)
+  {
+    report[i] = (uint8_t)(report[i] - 0x17) ^ 0x17;
+  }
+}
+
+void NunchuckSim::received(const uint8_t *data, size_t len, uint64_t /* now */)
+{
+  if (len == 2 && data[0] == 0x40 && data[1] == 0x00)
+  {
+    initialised = true;
+  }
+
+  // conversion request, the report is sampled now and read later
+  if (len == 1 && data[0] == 0x00)
+  {
+    encode();
+  }
+}
+
+size_t NunchuckSim::requested(uint8_t *data, size_t len, uint64_t /* now */)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    data[i] = initialised == true && i < 6 ? report[i] : 0xFF;
+  }
+
+  return len;
+}
+
+/*
+ * VL53L0X
+ */
+
+#define VL_SYSRANGE_START 0x00
+#define VL_SYSTEM_INTERRUPT_CLEAR 0x0B
+#define VL_RESULT_INTERRUPT_STATUS 0x13
+#define VL_RESULT_RANGE_STATUS 0x14
+#define VL_MODEL_ID 0xC0
+
+VL53L0XSim::VL53L0XSim(uint8_t address) : I2CSimDevice(address), rangeMilliMeter(8190), deviceRangeStatus(11), timingBudgetMicros(33000), pointer(0), ranging(false), continuous(false), readyAt(0)
+{
+  memset(registers, 0, sizeof(registers));
+  registers[VL_MODEL_ID] = 0xEE;
+  registers[VL_MODEL_ID + 1] = 0xAA;
+  registers[VL_MODEL_ID + 2] = 0x10;
+}
+
+// finish the measurement in progress once its timing budget has passed
+void VL53L0XSim::update(uint64_t now)
+{
+  if (ranging == false || now < readyAt)
+  {
+    return;
+  }
+
+  registers[VL_RESULT_INTERRUPT_STATUS] = (registers[VL_RESULT_INTERRUPT_STATUS] & ~0x07) | 0x04;
+  registers[VL_RESULT_RANGE_STATUS] = (deviceRangeStatus << 3) | 0x01;
+  registers[VL_RESULT_RANGE_STATUS + 10] = rangeMilliMeter >> 8;
+  registers[VL_RESULT_RANGE_STATUS + 11] = rangeMilliMeter & 0xFF;
+
+  if (continuous == true)
+  {
+    while (readyAt <= now)
+    {
+      readyAt += timingBudgetMicros;
+    }
+  }
+  else
+  {
+    ranging = false;
+  }
+}
+
+void VL53L0XSim::received(const uint8_t *data, size_t len, uint64_t now)
+{
+  if (len == 0)
+  {
+    return;
+  }
+
+  update(now);
+
+  pointer = data[0];
+
+  for (size_t i = 1; i < len; i++, pointer++)
+  {
+    if (pointer == VL_SYSRANGE_START)
+    {
+      // bit 0 starts, bit 1 back to back, bit 2 timed, 0 stops
+      ranging = (data[i] & 0x01) != 0;
+      continuous = (data[i] & 0x06) != 0;
+      readyAt = now + timingBudgetMicros;
+      registers[pointer] = data[i] & ~0x01; // start bit clears once the measurement starts
+      continue;
+    }
+
+    if (pointer == VL_SYSTEM_INTERRUPT_CLEAR && data[i] != 0)
+    {
+      registers[VL_RESULT_INTERRUPT_STATUS] &= ~0x07;
+    }
+
+    registers[pointer] = data[i];
+  }
+}
+
+size_t VL53L0XSim::requested(uint8_t *data, size_t len, uint64_t now)
+{
+  update(now);
+
+  for (size_t i = 0; i < len; i++)
+  {
+    data[i] = registers[pointer++];
+  }
+
+  return len;
+}
@@ -0,0 +1,214 @@
+/*
+   I2CSim - in-memory I2C bus and device models for the native build.
+
+   I2CSimBus has the subset of the TwoWire API our drivers use. Wire.h and
+   Arduino.h next to this file stand in for the ESP8266 core in the native
+   env, so the drivers and i2cBus.cpp build unchanged against a TwoWire that
+   is an I2CSimBus, with millis() and micros() on its clock. Every
+   transaction advances a simulated microsecond clock by its bit time at the
+   configured bus clock plus the device's latency; nothing sleeps, so
+   benchmarks run as fast as the host allows.
+
+   Devices are scriptable: set the field, range or report they should produce,
+   add latency and inject faults (NACK, short read, corrupted bytes, SDA held
+   low) for a number of transactions. A device holding SDA lets go after
+   sdaHoldClocks SCL clocks driven through digitalWrite(), the way a slave
+   stuck half way through a byte does, and bit-banged starts and stops are
+   counted.
+ */
+
+#ifndef I2CSim_h
+
+#define I2CSim_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define I2CSIM_MAX_DEVICES 8
+#define I2CSIM_BUFFER_LENGTH 32
+#define I2CSIM_HOLD_CLOCKS 9 // worst case, 8 data bits and the ack
+
+// the two bus lines, for drive() and level()
+#define I2CSIM_SDA 0
+#define I2CSIM_SCL 1
+
+// Wire.status() values, as the ESP8266 core
+#define I2CSIM_OK 0
+#define I2CSIM_SDA_HELD_LOW 3
+
+enum I2CSimFault
+{
+  I2CSIM_FAULT_NONE = 0,
+  I2CSIM_FAULT_NACK,       // address not acknowledged
+  I2CSIM_FAULT_SHORT_READ, // device stops sending half way through a read
+  I2CSIM_FAULT_CORRUPT,    // read bytes are inverted
+  I2CSIM_FAULT_HOLD_SDA    // device holds SDA low until the bus is clocked free
+};
+
+class I2CSimDevice
+{
+public:
+  I2CSimDevice(uint8_t address);
+  virtual ~I2CSimDevice() {}
+
+  uint8_t address;
+  uint32_t latencyMicros; // added to every transaction with this device
+  bool attached;          // false simulates an unplugged device
+
+  void injectFault(I2CSimFault fault, uint32_t transactions = 1);
+  I2CSimFault takeFault();
+
+  uint32_t writes;
+  uint32_t reads;
+
+  // master wrote len bytes to the device
+  virtual void received(const uint8_t *data, size_t len, uint64_t now) = 0;
+  // master reads len bytes, returns how many the device supplied
+  virtual size_t requested(uint8_t *data, size_t len, uint64_t now) = 0;
+
+private:
+  I2CSimFault fault;
+  uint32_t faultCount;
+};
+
+class I2CSimBus
+{
+public:
+  I2CSimBus();
+
+  void attach(I2CSimDevice &device);
+
+  // TwoWire API
+  void begin();
+  void setClock(uint32_t frequency);
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t len);
+  uint8_t endTransmission(uint8_t sendStop = 1);
+  uint8_t requestFrom(uint8_t address, uint8_t len, uint8_t sendStop = 1);
+  int available();
+  int read();
+  uint8_t status();
+
+  // simulated time
+  uint64_t micros();
+  void advance(uint64_t micros);
+
+  // 9 SCL clocks and a stop, releases a device holding SDA
+  void clockOut();
+
+  // the lines as pins, high is released to the pull up
+  void drive(uint8_t line, bool high);
+  bool level(uint8_t line);
+
+  uint32_t clock;
+  uint32_t transactions;
+  uint32_t errors;
+  uint8_t sdaHoldClocks; // SCL clocks a device holding SDA needs before it lets go
+  uint32_t sclClocks;    // rising edges driven through drive()
+  uint32_t starts;       // SDA falling while SCL is high
+  uint32_t stops;        // SDA rising while SCL is high
+
+private:
+  I2CSimDevice *devices[I2CSIM_MAX_DEVICES];
+  uint8_t deviceCount;
+  bool sdaHeld;
+  uint8_t holdClocksLeft;
+  bool sdaDriven; // master's side of the lines, true while released
+  bool sclDriven;
+  uint64_t now;
+  uint8_t txAddress;
+  uint8_t txBuffer[I2CSIM_BUFFER_LENGTH];
+  uint8_t txLength;
+  uint8_t rxBuffer[I2CSIM_BUFFER_LENGTH];
+  uint8_t rxLength;
+  uint8_t rxIndex;
+  I2CSimDevice *find(uint8_t address);
+  void spend(size_t bytes, I2CSimDevice *device, bool stop = true);
+  void hold();
+};
+
+// LOLIN I2C motor shield, GET_SLAVE_STATUS/CHANGE_STATUS/CHANGE_FREQ/CHANGE_DUTY
+class LolinMotorSim : public I2CSimDevice
+{
+public:
+  LolinMotorSim(uint8_t address = 0x30);
+
+  uint8_t status[2];
+  uint16_t duty[2]; // hundredths of a percent, as sent
+  uint32_t freq[2];
+  uint32_t commands;
+  uint32_t replyDelayMicros; // reads earlier than this after a command get the previous reply
+
+  void received(const uint8_t *data, size_t len, uint64_t now);
+  size_t requested(uint8_t *data, size_t len, uint64_t now);
+
+private:
+  uint8_t reply[2];
+  uint8_t pendingReply[2];
+  uint64_t replyReadyAt;
+};
+
+// QMC5883L magnetometer, data/status/temperature registers, chip id, ROL_PNT
+class QMC5883LSim : public I2CSimDevice
+{
+public:
+  QMC5883LSim(uint8_t address = 0x0D);
+
+  // the field reported by the next samples
+  int16_t x, y, z, t;
+  uint8_t registers[14];
+
+  void received(const uint8_t *data, size_t len, uint64_t now);
+  size_t requested(uint8_t *data, size_t len, uint64_t now);
+
+private:
+  uint8_t pointer;
+  uint64_t nextSampleAt;
+  void sample(uint64_t now);
+  uint32_t periodMicros();
+};
+
+// Wii nunchuck, 0x40 0x00 handshake, 0x00 conversion request, 6 byte encoded report
+class NunchuckSim : public I2CSimDevice
+{
+public:
+  NunchuckSim(uint8_t address = 0x52);
+
+  uint8_t joyX, joyY;
+  uint16_t accelX, accelY, accelZ; // 10 bit
+  bool zButton, cButton;
+  bool initialised;
+
+  void received(const uint8_t *data, size_t len, uint64_t now);
+  size_t requested(uint8_t *data, size_t len, uint64_t now);
+
+private:
+  uint8_t report[6];
+  void encode();
+};
+
+// VL53L0X, generic register file with model id, SYSRANGE_START,
+// RESULT_INTERRUPT_STATUS, SYSTEM_INTERRUPT_CLEAR and the range status block
+class VL53L0XSim : public I2CSimDevice
+{
+public:
+  VL53L0XSim(uint8_t address = 0x29);
+
+  uint16_t rangeMilliMeter;  // the range reported by the next measurement
+  uint8_t deviceRangeStatus; // as the chip reports it, 11 is a valid range
+  uint32_t timingBudgetMicros;
+  uint8_t registers[256];
+
+  void received(const uint8_t *data, size_t len, uint64_t now);
+  size_t requested(uint8_t *data, size_t len, uint64_t now);
+
+private:
+  uint8_t pointer;
+  bool ranging;
+  bool continuous;
+  uint64_t readyAt;
+  void update(uint64_t now);
+};
+
+#endif
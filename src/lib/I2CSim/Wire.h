@@ -0,0 +1,35 @@
+/*
+   Wire.h for the native env - a TwoWire that is an I2CSimBus, so drivers
+   written against the ESP8266 core talk to the I2CSim device models.
+
+   Attach the models to Wire before the driver under test begins:
+     QMC5883LSim compass;
+     Wire.attach(compass);
+ */
+
+#ifndef TwoWire_h
+
+#define TwoWire_h
+
+#include "Arduino.h"
+#include "I2CSim.h"
+
+// Wire.status() values, as the ESP8266 core
+#define I2C_OK I2CSIM_OK
+#define I2C_SDA_HELD_LOW I2CSIM_SDA_HELD_LOW
+
+class TwoWire : public I2CSimBus
+{
+public:
+  using I2CSimBus::begin;
+  void begin(int /* sda */, int /* scl */) { begin(); }
+  void setClockStretchLimit(uint32_t /* limit */) {}
+
+  // int like the core's overloads, so any mix of argument types resolves
+  void beginTransmission(int address) { I2CSimBus::beginTransmission((uint8_t)address); }
+  uint8_t requestFrom(int address, int len, int sendStop = 1) { return I2CSimBus::requestFrom((uint8_t)address, (uint8_t)len, (uint8_t)sendStop); }
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -2,10 +2,12 @@
 
 /* 
 	Init
+
+		This assumes the wire library has been initialized, beginning it here
+		would reset whatever bus clock was configured.
 */
 LOLIN_I2C_MOTOR::LOLIN_I2C_MOTOR(uint8_t address)
 {
-	Wire.begin();
 	_address = address;
 }
 
@@ -24,13 +26,16 @@ LOLIN_I2C_MOTOR::LOLIN_I2C_MOTOR(uint8_t address)
 				MOTOR_STATUS_SHORT_BRAKE
 				MOTOR_STATUS_STANDBY
 
+		waitReply: false returns as soon as the command is written,
+				without the 50ms wait for the shield's reply
+
 */
-unsigned char LOLIN_I2C_MOTOR::changeStatus(unsigned char ch, unsigned char sta)
+unsigned char LOLIN_I2C_MOTOR::changeStatus(unsigned char ch, unsigned char sta, bool waitReply)
 {
 	send_data[0] = CHANGE_STATUS;
 	send_data[1] = ch;
 	send_data[2] = sta;
-	unsigned char result = sendData(send_data, 3);
+	unsigned char result = sendData(send_data, 3, waitReply);
 
 	return result;
 }
@@ -70,8 +75,11 @@ unsigned char LOLIN_I2C_MOTOR::changeFreq(unsigned char ch, uint32_t freq)
 		duty: PWM Duty (%)
 				0.01 - 100.00 (%)
 
+		waitReply: false returns as soon as the command is written,
+				as changeStatus
+
 */
-unsigned char LOLIN_I2C_MOTOR::changeDuty(unsigned char ch, float duty)
+unsigned char LOLIN_I2C_MOTOR::changeDuty(unsigned char ch, float duty, bool waitReply)
 {
 	uint16_t _duty;
 	_duty = (uint16_t)(duty * 100);
@@ -81,7 +89,7 @@ unsigned char LOLIN_I2C_MOTOR::changeDuty(unsigned char ch, float duty)
 
 	send_data[2] = (uint8_t)(_duty & 0xff);
 	send_data[3] = (uint8_t)((_duty >> 8) & 0xff);
-	unsigned char result = sendData(send_data, 4);
+	unsigned char result = sendData(send_data, 4, waitReply);
 
 	return result;
 }
@@ -134,7 +142,7 @@ unsigned char LOLIN_I2C_MOTOR::getInfo(void)
 /*
 	Send and Get I2C Data
 */
-unsigned char LOLIN_I2C_MOTOR::sendData(unsigned char *data, unsigned char len)
+unsigned char LOLIN_I2C_MOTOR::sendData(unsigned char *data, unsigned char len, bool waitReply)
 {
 	unsigned char i;
 
@@ -149,6 +157,10 @@ unsigned char LOLIN_I2C_MOTOR::sendData(unsigned char *data, unsigned char len)
 		for (i = 0; i < len; i++)
 			Wire.write(data[i]);
 		Wire.endTransmission();
+
+		if (!waitReply)
+			return 0;
+
 		delay(50);
 
 		if (data[0] == GET_SLAVE_STATUS)
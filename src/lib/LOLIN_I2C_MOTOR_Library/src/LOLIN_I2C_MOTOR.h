@@ -51,9 +51,9 @@ class LOLIN_I2C_MOTOR
 	unsigned char changeAddress(unsigned char address);
   unsigned char getInfo(void);
   
-  unsigned char changeStatus(unsigned char ch, unsigned char sta);
+  unsigned char changeStatus(unsigned char ch, unsigned char sta, bool waitReply = true);
   unsigned char changeFreq(unsigned char ch, uint32_t freq);
-  unsigned char changeDuty(unsigned char ch, float duty);
+  unsigned char changeDuty(unsigned char ch, float duty, bool waitReply = true);
 
   unsigned char VERSION=0;
   unsigned char PRODUCT_ID=0;
@@ -62,7 +62,7 @@ class LOLIN_I2C_MOTOR
 	unsigned char _address;
 	unsigned char send_data[5] = {0};
 	unsigned char get_data[2]={0};
-	unsigned char sendData(unsigned char *data, unsigned char len);
+	unsigned char sendData(unsigned char *data, unsigned char len, bool waitReply = true);
 };
 
 #endif
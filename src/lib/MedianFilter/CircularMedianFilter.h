@@ -0,0 +1,111 @@
+/*
+   CircularMedianFilter - median filter for angles, for the Arduino platform.
+
+   Angles wrap, so a plain median of headings either side of north comes out
+   near south. Each new angle is unwrapped to within half a period of the
+   current median before it goes into a MedianFilter, which makes the window
+   a continuous run of values whose median is the median on the circle. The
+   result is wrapped back into 0 .. period-1.
+
+   The window is seeded from the first sample rather than a fixed value, and
+   shifted back by whole periods when the heading has turned a few times, so
+   nothing overflows however long the car spins. Cost per sample is that of
+   MedianFilter.
+ */
+
+#ifndef CircularMedianFilter_h
+
+   #define CircularMedianFilter_h
+
+   #include <stdlib.h>
+   #include "MedianFilter.h"
+
+   #define CIRCULAR_MAX_TURNS 4   // unwrapped median kept within this many periods of zero
+
+   template <size_t N>
+   class CircularMedianFilter
+   {
+      public:
+         CircularMedianFilter(int period);  // period: 360 for degrees, 3600 for tenths
+         int in(const int & value);
+         int out();
+         bool seeded();
+         int getIqr();
+
+      private:
+         MedianFilter<int, N> filter;
+         int  period;
+         int  median;      // unwrapped
+         bool started;
+         int  wrap(int value);
+   };
+
+
+   template <size_t N>
+   CircularMedianFilter<N>::CircularMedianFilter(int period) : filter(0)
+   {
+      this->period = period;
+      median       = 0;
+      started      = false;
+   }
+
+
+   template <size_t N>
+   int CircularMedianFilter<N>::in(const int & value)
+   {
+      if(!started)  // seed the window with the first real sample
+      {
+         median  = wrap(value);
+         started = true;
+         filter.reset(median);
+      }
+
+      // the same angle within half a period of the median
+      int unwrapped = median + wrap(value - median + period / 2) - period / 2;
+
+      median = filter.in(unwrapped);
+
+      // turned a few times, bring the whole window back by whole periods
+      if(abs(median) > CIRCULAR_MAX_TURNS * period)
+      {
+         int delta = -(median / period) * period;
+
+         filter.shift(delta);
+         median += delta;
+      }
+
+      return wrap(median);
+   }
+
+
+   template <size_t N>
+   int CircularMedianFilter<N>::out()  // return the last median, 0 .. period-1
+   {
+      return wrap(median);
+   }
+
+
+   template <size_t N>
+   bool CircularMedianFilter<N>::seeded()  // false until the first sample
+   {
+      return started;
+   }
+
+
+   template <size_t N>
+   int CircularMedianFilter<N>::getIqr()  // spread of the middle half, the window is unwrapped so this is too
+   {
+      return filter.getIqr();
+   }
+
+
+   template <size_t N>
+   int CircularMedianFilter<N>::wrap(int value)  // into 0 .. period-1
+   {
+      value %= period;
+      if(value < 0) value += period;
+
+      return value;
+   }
+
+#endif
@@ -0,0 +1,218 @@
+/*
+   HampelFilter - streaming outlier rejection for the Arduino platform.
+
+   Keeps a sliding window next to a sorted copy of it. Each new sample is
+   compared with the window's median; if it is further away than threshold
+   times the scaled median absolute deviation (1.4826 * MAD, the standard
+   deviation for normally distributed data) it is counted as rejected and
+   the median is returned in its place. The sample joins the window either
+   way, so a real step change is accepted once it fills half the window.
+   With highOnly only samples above the median are replaced, for a range
+   where hiding a closer reading for even a few samples is worse than
+   passing on a spike.
+
+   The median is read straight from the sorted window and the MAD is found
+   with a binary search over the distances either side of it, so a sample
+   costs O(log n) comparisons plus a memmove of the sorted window.
+
+   A HampelFilter<T, N> holds its window of N samples in two std::arrays
+   inside the object, nothing is allocated, and like MedianFilter it builds
+   on a host too.
+
+   Samples are passed through unchecked until the window has filled.
+ */
+
+#ifndef HampelFilter_h
+
+   #define HampelFilter_h
+
+   #include <string.h>
+   #include "MedianFilter.h"
+
+   template <typename T, size_t N>
+   class HampelFilter
+   {
+      static_assert(N >= 3, "HampelFilter window must be at least 3");
+
+      public:
+         typedef typename MedianFilterIndex<N>::type index_t;
+         typedef typename MedianFilterTraits<T>::square_t square_t;
+
+         // thresholdTenths: rejection threshold in tenths of a scaled MAD,
+         // minMad: floor for the MAD so a constant window doesn't reject
+         // every change, highOnly: leave samples below the median alone
+         HampelFilter(int thresholdTenths, T minMad, bool highOnly = false);
+         T in(const T & value);
+         T out();
+         void reset();              // empty the window, the counters carry on
+
+         T getMedian();
+         T getMad();
+         uint32_t getRejected();
+         uint32_t getSamples();
+
+      private:
+         index_t  count;            // samples in the window so far
+         index_t  oldest;           // oldest data point location in ring buffer
+         std::array<T, N> data;     // window in age order, ring buffer
+         std::array<T, N> sorted;   // window in size order
+         int      thresholdTenths;
+         T        minMad;
+         bool     highOnly;
+         T        output;
+         uint32_t rejected;
+         uint32_t samples;
+         index_t  lowerBound(const T & value);
+   };
+
+
+   template <typename T, size_t N>
+   HampelFilter<T, N>::HampelFilter(int thresholdTenths, T minMad, bool highOnly)
+   {
+      this->thresholdTenths = thresholdTenths;
+      this->minMad    = minMad;
+      this->highOnly  = highOnly;
+      rejected        = 0;
+      samples         = 0;
+      reset();
+   }
+
+
+   template <typename T, size_t N>
+   void HampelFilter<T, N>::reset()
+   {
+      count  = 0;
+      oldest = 0;
+      output = T();
+   }
+
+
+   template <typename T, size_t N>
+   T HampelFilter<T, N>::in(const T & value)
+   {
+      samples++;
+      output = value;
+
+      if(count == N)
+      {
+         const T median = getMedian();
+         const T deviation = value > median ? value - median : median - value;
+         const T mad = getMad() > minMad ? getMad() : minMad;
+
+         // deviation > threshold * 1.4826 * mad, kept in integers
+         if((highOnly == false || value > median) && square_t(deviation) * 100000 > square_t(thresholdTenths) * 14826 * square_t(mad))
+         {
+            output = median;
+            rejected++;
+         }
+
+         // drop the oldest sample from the sorted window
+         index_t i = lowerBound(data[oldest]);
+         memmove(&sorted[i], &sorted[i + 1], (count - i - 1) * sizeof(T));
+         count--;
+      }
+
+      // add the new one in its place
+      index_t i = lowerBound(value);
+      memmove(&sorted[i + 1], &sorted[i], (count - i) * sizeof(T));
+      sorted[i] = value;
+      count++;
+
+      data[oldest] = value;
+      oldest++;                 // increment and wrap
+      if(oldest == N) oldest = 0;
+
+      return output;
+   }
+
+
+   template <typename T, size_t N>
+   T HampelFilter<T, N>::out() // return the last output
+   {
+      return output;
+   }
+
+
+   template <typename T, size_t N>
+   T HampelFilter<T, N>::getMedian()
+   {
+      return sorted[count >> 1];
+   }
+
+
+   // median of |x - median| over the window. The distances left of the median
+   // and right of it are each already sorted, so this is the k-th smallest of
+   // two sorted lists, found by binary search on how many come from the left
+   template <typename T, size_t N>
+   T HampelFilter<T, N>::getMad()
+   {
+      if(count == 0) return T();
+
+      const int mid    = count >> 1;
+      const T   median = sorted[mid];
+      const int nLeft  = mid;           // left[j]  = median - sorted[mid - 1 - j]
+      const int nRight = count - mid;   // right[j] = sorted[mid + j] - median
+      const int k      = count >> 1;    // 0 based rank of the MAD
+
+      int lo = k + 1 - nRight > 0 ? k + 1 - nRight : 0;
+      int hi = k + 1 < nLeft ? k + 1 : nLeft;
+
+      while(lo < hi)
+      {
+         int i = (lo + hi) >> 1;        // distances taken from the left
+         int j = k + 1 - i;             // and from the right
+
+         if(j > 0 && i < nLeft && sorted[mid + j - 1] - median > median - sorted[mid - 1 - i])
+         {
+            lo = i + 1;
+         }
+         else
+         {
+            hi = i;
+         }
+      }
+
+      int i = lo;
+      int j = k + 1 - i;
+      T mad = T();
+
+      if(i > 0) mad = median - sorted[mid - i];
+      if(j > 0 && sorted[mid + j - 1] - median > mad) mad = sorted[mid + j - 1] - median;
+
+      return mad;
+   }
+
+
+   template <typename T, size_t N>
+   uint32_t HampelFilter<T, N>::getRejected()
+   {
+      return rejected;
+   }
+
+
+   template <typename T, size_t N>
+   uint32_t HampelFilter<T, N>::getSamples()
+   {
+      return samples;
+   }
+
+
+   // first position in the sorted window not less than value
+   template <typename T, size_t N>
+   typename HampelFilter<T, N>::index_t HampelFilter<T, N>::lowerBound(const T & value)
+   {
+      index_t lo = 0;
+      index_t hi = count;
+
+      while(lo < hi)
+      {
+         index_t m = (lo + hi) >> 1;
+
+         if(sorted[m] < value) lo = m + 1;
+         else hi = m;
+      }
+
+      return lo;
+   }
+
+#endif
@@ -18,50 +18,350 @@
 */
 
 /*
-   A median filter object is created by by passing the desired filter window size on object creation.
-   The window size should be an odd number between 3 and 255.
+   A median filter object is created with its sample type and window size as template arguments,
+   MedianFilter<int, 15> filter(seed);  The window size should be odd and at least 3.
 
    New data is added to the median filter by passing the data through the in() function.  The new medial value is returned.
    The new data will over-write the oldest data point, then be shifted in the array to place it in the correct location.
 
    The current median value is returned by the out() function for situations where the result is desired without passing in new data.
+   Any other order statistic is read the same way from the sorted map, getRank(), getPercentile() and getIqr().
+
+   Storage is three std::arrays inside the object, nothing is allocated.  The map indices are the smallest unsigned
+   type that holds N, and the running sum and sum of squares are wide enough for the sample type (see
+   MedianFilterTraits, specialise it for a fixed-point type), so getMean(), getVariance() and getStDev() don't
+   look at the window.  Only <stdint.h>, <array> and <math.h> are needed, so the filter builds on a host too.
+
+   Window Size / avg processing time [us], tools/median_bench repeats the measurement on a host
+   5  / 22
+   7  / 30
+   9  / 40
+   11 / 49
+   21 / 99
 
-   !!! All data must be type INT.  !!!
  */
 
 #ifndef MedianFilter_h
 
    #define MedianFilter_h
 
-   #include "Arduino.h"
+   #include <stdint.h>
+   #include <stddef.h>
+   #include <math.h>
+   #include <array>
+   #include <type_traits>
+
+   // the running sum types for a sample type, double for floating point. The sum of squares is
+   // 64 bit for any integer, which holds N * N * sample * sample, so 32 bit samples must stay
+   // within +-2^31 / N for the standard deviation
+   template <typename T>
+   struct MedianFilterTraits
+   {
+      typedef typename std::conditional<std::is_floating_point<T>::value, double,
+              typename std::conditional<(sizeof(T) < 4), int32_t, int64_t>::type>::type sum_t;
+      typedef typename std::conditional<std::is_floating_point<T>::value, double, int64_t>::type square_t;
+   };
+
+   // smallest unsigned type that can index a window of N samples
+   template <size_t N>
+   struct MedianFilterIndex
+   {
+      typedef typename std::conditional<(N <= 0x100), uint8_t,
+              typename std::conditional<(N <= 0x10000), uint16_t, uint32_t>::type>::type type;
+   };
+
+   // floor of the square root, one result bit per pass
+   inline uint32_t medianFilterSqrt(uint64_t value)
+   {
+      uint64_t root = 0;
+      uint64_t bit  = (uint64_t)1 << 62;
+
+      while(bit > value) bit >>= 2;
+
+      while(bit != 0)
+      {
+         if(value >= root + bit)
+         {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+         }
+         else
+         {
+            root >>= 1;
+         }
+         bit >>= 2;
+      }
+
+      return (uint32_t)root;
+   }
+
+   // running sum and sum of squares of a window of N samples, kept up to date as samples are
+   // replaced so the mean and standard deviation cost the same at any window size
+   template <typename T, size_t N>
+   class MedianFilterMoments
+   {
+      public:
+         typedef typename MedianFilterTraits<T>::sum_t sum_t;
+         typedef typename MedianFilterTraits<T>::square_t square_t;
+
+         void reset(T seed)
+         {
+            totalSum     = sum_t(seed) * sum_t(N);
+            totalSquares = square_t(seed) * square_t(seed) * square_t(N);
+         }
+
+         void replace(T oldest, T value)
+         {
+            totalSum     += sum_t(value) - sum_t(oldest);
+            totalSquares += square_t(value) * square_t(value) - square_t(oldest) * square_t(oldest);
+         }
+
+         void shift(T delta)  // (x + d)^2 summed is the squares + 2d * sum + N * d^2
+         {
+            totalSquares += 2 * square_t(delta) * square_t(totalSum) + square_t(delta) * square_t(delta) * square_t(N);
+            totalSum     += sum_t(delta) * sum_t(N);
+         }
+
+         T mean()
+         {
+            return T(totalSum / sum_t(N));
+         }
+
+         square_t variance()  // sample variance, rounded down for integers
+         {
+            return spread() / square_t(N * (N - 1));
+         }
+
+         T stDev()
+         {
+            return root(spread(), std::is_floating_point<T>());
+         }
 
+      private:
+         sum_t    totalSum;
+         square_t totalSquares;
+
+         square_t spread()  // N * N * population variance, never negative
+         {
+            square_t spread = square_t(N) * totalSquares - square_t(totalSum) * square_t(totalSum);
+            return spread > 0 ? spread : 0;
+         }
+
+         static T root(square_t spread, std::true_type)
+         {
+            return T(sqrt(spread / square_t(N * (N - 1))));
+         }
+
+         static T root(square_t spread, std::false_type)  // rounded, from the floor of twice the root
+         {
+            return T((medianFilterSqrt(uint64_t(4 * spread / square_t(N * (N - 1)))) + 1) >> 1);
+         }
+   };
+
+   // move the sample just written to slot into its place in sizeMap, shared with MedianFilterBank
+   template <typename T, size_t N, typename index_t>
+   inline void medianFilterSort(const T *data, index_t *sizeMap, index_t *locationMap, index_t slot)
+   {
+      // sort sizeMap
+      // small vaues on the left (-)
+      // larger values on the right (+)
+
+      bool dataMoved = false;
+      const size_t rightEdge = N - 1;  // adjusted for zero indexed array
+
+      // SORT LEFT (-) <======(n) (+)
+      if(locationMap[slot] > 0) // don't check left neighbours if at the extreme left
+      {
+         for(size_t i = locationMap[slot]; i > 0; i--)   //index through left adjacent data
+         {
+            size_t n = i - 1;   // neighbour location
+
+            if(data[slot] < data[sizeMap[n]]) // find insertion point, move old data into position
+            {
+               sizeMap[i] = sizeMap[n];   // move existing data right so the new data can go left
+               locationMap[sizeMap[n]]++;
+
+               sizeMap[n] = slot; // assign new data to neighbor position
+               locationMap[slot]--;
+
+               dataMoved = true;
+            }
+            else
+            {
+               break; // stop checking once a smaller value is found on the left
+            }
+         }
+      }
+
+      // SORT RIGHT (-) (n)======> (+)
+      if(!dataMoved && locationMap[slot] < rightEdge) // don't check right if at right border, or the data has already moved
+      {
+         for(size_t i = locationMap[slot]; i < rightEdge; i++)   //index through left adjacent data
+         {
+            size_t n = i + 1;   // neighbour location
+
+            if(data[sizeMap[n]] < data[slot]) // find insertion point, move old data into position
+            {
+               sizeMap[i] = sizeMap[n];   // move existing data left so the new data can go right
+               locationMap[sizeMap[n]]--;
+
+               sizeMap[n] = slot; // assign new data to neighbor position
+               locationMap[slot]++;
+            }
+            else
+            {
+               break; // stop checking once a smaller value is found on the right
+            }
+         }
+      }
+   }
+
+   template <typename T, size_t N>
    class MedianFilter
    {
+      static_assert(N >= 3, "MedianFilter window must be at least 3");
+
       public:
-         MedianFilter(int size, int seed);
-         int in(const int & value);
-         int out();
-
-         int getMin();
-         int getMax();
-         int getMean();
-         int getStDev();
-
-         /*
-         void printData();		// used for debugging
-         void printSizeMap();
-         void printLocationMap();
-         void printSortedData();
-         */
+         typedef typename MedianFilterIndex<N>::type index_t;
+         typedef typename MedianFilterTraits<T>::square_t square_t;
+
+         MedianFilter(T seed = T());
+         T in(const T & value);
+         T out();
+         void reset(T seed);
+         void shift(T delta);
+
+         T getMin();
+         T getMax();
+         T getRank(size_t k);
+         T getPercentile(uint8_t percent);
+         T getIqr();
+         T getMean();
+         square_t getVariance();
+         T getStDev();
 
       private:
-         uint8_t medFilterWin;      // number of samples in sliding median filter window - usually odd #
-         uint8_t medDataPointer;	   // mid point of window
-         int     * data;			   // array pointer for data sorted by age in ring buffer
-         uint8_t * sizeMap;			// array pointer for locations data in sorted by size
-         uint8_t * locationMap;		// array pointer for data locations in history map
-         uint8_t oldestDataPoint;	// oldest data point location in ring buffer
-         int32_t totalSum;
+         static const index_t medDataPointer = N >> 1;  // mid point of window
+         std::array<T, N>       data;          // data sorted by age in ring buffer
+         std::array<index_t, N> sizeMap;       // locations of data sorted by size
+         std::array<index_t, N> locationMap;   // locations of history data in map list
+         index_t oldestDataPoint;              // oldest data point location in ring buffer
+         MedianFilterMoments<T, N> moments;
    };
 
+
+   template <typename T, size_t N>
+   MedianFilter<T, N>::MedianFilter(T seed)
+   {
+      reset(seed);
+   }
+
+
+   template <typename T, size_t N>
+   void MedianFilter<T, N>::reset(T seed)  // refill the window with the seed value
+   {
+      oldestDataPoint = medDataPointer;      // oldest data point location in data array
+      moments.reset(seed);
+
+      for(size_t i = 0; i < N; i++) // initialize the arrays
+      {
+         sizeMap[i]     = i;      // start map with straight run
+         locationMap[i] = i;      // start map with straight run
+         data[i]        = seed;   // populate with seed value
+      }
+   }
+
+
+   template <typename T, size_t N>
+   void MedianFilter<T, N>::shift(T delta)  // add delta to every sample, the order doesn't change
+   {
+      for(size_t i = 0; i < N; i++)
+      {
+         data[i] += delta;
+      }
+
+      moments.shift(delta);
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::in(const T & value)
+   {
+      moments.replace(data[oldestDataPoint], value);  // add new value and remove oldest value
+
+      data[oldestDataPoint] = value;  // store new data in location of oldest data in ring buffer
+
+      medianFilterSort<T, N>(data.data(), sizeMap.data(), locationMap.data(), oldestDataPoint);
+
+      oldestDataPoint++;       // increment and wrap
+      if(oldestDataPoint == N) oldestDataPoint = 0;
+
+      return data[sizeMap[medDataPointer]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::out() // return the value of the median data sample
+   {
+      return  data[sizeMap[medDataPointer]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getMin()
+   {
+      return data[sizeMap[ 0 ]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getMax()
+   {
+      return data[sizeMap[ N - 1 ]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getRank(size_t k)  // k-th smallest sample, 0 is the minimum
+   {
+      return data[sizeMap[ k < N ? k : N - 1 ]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getPercentile(uint8_t percent)  // nearest rank, 0 .. 100
+   {
+      if(percent > 100) percent = 100;
+
+      return getRank((percent * (N - 1) + 50) / 100);
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getIqr()  // interquartile range, the spread of the middle half
+   {
+      return getPercentile(75) - getPercentile(25);
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getMean()
+   {
+      return moments.mean();
+   }
+
+
+   template <typename T, size_t N>
+   typename MedianFilter<T, N>::square_t MedianFilter<T, N>::getVariance()
+   {
+      return moments.variance();
+   }
+
+
+   template <typename T, size_t N>
+   T MedianFilter<T, N>::getStDev()  // rounded to the nearest whole sample unit for integers
+   {
+      return moments.stDev();
+   }
+
 #endif
@@ -0,0 +1,195 @@
+/*
+   MedianFilterBank - K median filters of the same window that are fed together,
+   for the Arduino platform.
+
+   in() takes one sample for every channel and returns the K medians. The
+   channels share one ring index, and the windows, size maps and location
+   maps of all channels are three arrays inside the object, each channel's
+   part contiguous, so there is no per-filter object to chase and a batch
+   touches one block of memory. The sort is the one MedianFilter uses,
+   run once per channel.
+
+   The per-channel readers take the channel as their first argument and
+   match MedianFilter's. tools/median_bench compares a bank with K separate
+   MedianFilters on a host, -D MEDIAN_BENCHMARK does the same on the car.
+ */
+
+#ifndef MedianFilterBank_h
+
+   #define MedianFilterBank_h
+
+   #include "MedianFilter.h"
+
+   template <typename T, size_t K, size_t N>
+   class MedianFilterBank
+   {
+      static_assert(K >= 1, "MedianFilterBank needs at least one channel");
+      static_assert(N >= 3, "MedianFilterBank window must be at least 3");
+
+      public:
+         typedef typename MedianFilterIndex<N>::type index_t;
+         typedef typename MedianFilterTraits<T>::square_t square_t;
+
+         MedianFilterBank(T seed = T());
+         const T * in(const T * samples);   // K samples in, K medians out
+         const T * out();
+         T out(size_t channel);
+         void reset(T seed);
+         void shift(size_t channel, T delta);
+
+         T getMin(size_t channel);
+         T getMax(size_t channel);
+         T getRank(size_t channel, size_t k);
+         T getPercentile(size_t channel, uint8_t percent);
+         T getIqr(size_t channel);
+         T getMean(size_t channel);
+         square_t getVariance(size_t channel);
+         T getStDev(size_t channel);
+
+      private:
+         static const index_t medDataPointer = N >> 1;  // mid point of window
+         std::array<T, K * N>       data;          // each channel's ring buffer, channel after channel
+         std::array<index_t, K * N> sizeMap;       // each channel's ring slots sorted by size
+         std::array<index_t, K * N> locationMap;   // each channel's slot locations in its size map
+         std::array<T, K>           medians;       // the last median of every channel
+         std::array<MedianFilterMoments<T, N>, K> moments;
+         index_t oldestDataPoint;                  // oldest ring slot, the same in every channel
+   };
+
+
+   template <typename T, size_t K, size_t N>
+   MedianFilterBank<T, K, N>::MedianFilterBank(T seed)
+   {
+      reset(seed);
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   void MedianFilterBank<T, K, N>::reset(T seed)  // refill every window with the seed value
+   {
+      oldestDataPoint = medDataPointer;
+
+      for(size_t c = 0; c < K; c++)
+      {
+         for(size_t i = 0; i < N; i++)
+         {
+            sizeMap[c * N + i]     = i;
+            locationMap[c * N + i] = i;
+            data[c * N + i]        = seed;
+         }
+
+         medians[c] = seed;
+         moments[c].reset(seed);
+      }
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   void MedianFilterBank<T, K, N>::shift(size_t channel, T delta)  // add delta to one channel's samples
+   {
+      for(size_t i = 0; i < N; i++)
+      {
+         data[channel * N + i] += delta;
+      }
+
+      medians[channel] += delta;
+      moments[channel].shift(delta);
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   const T * MedianFilterBank<T, K, N>::in(const T * samples)
+   {
+      const index_t slot = oldestDataPoint;   // a local, the byte wide maps could alias the member
+
+      for(size_t c = 0; c < K; c++)
+      {
+         T * window = &data[c * N];
+         index_t * sizes = &sizeMap[c * N];
+
+         moments[c].replace(window[slot], samples[c]);
+         window[slot] = samples[c];
+
+         medianFilterSort<T, N>(window, sizes, &locationMap[c * N], slot);
+
+         medians[c] = window[sizes[medDataPointer]];
+      }
+
+      oldestDataPoint = slot + 1 == N ? 0 : slot + 1;   // increment and wrap
+
+      return medians.data();
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   const T * MedianFilterBank<T, K, N>::out()  // the K medians
+   {
+      return medians.data();
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::out(size_t channel)
+   {
+      return medians[channel];
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getMin(size_t channel)
+   {
+      return getRank(channel, 0);
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getMax(size_t channel)
+   {
+      return getRank(channel, N - 1);
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getRank(size_t channel, size_t k)  // k-th smallest sample, 0 is the minimum
+   {
+      return data[channel * N + sizeMap[channel * N + (k < N ? k : N - 1)]];
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getPercentile(size_t channel, uint8_t percent)  // nearest rank, 0 .. 100
+   {
+      if(percent > 100) percent = 100;
+
+      return getRank(channel, (percent * (N - 1) + 50) / 100);
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getIqr(size_t channel)
+   {
+      return getPercentile(channel, 75) - getPercentile(channel, 25);
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getMean(size_t channel)
+   {
+      return moments[channel].mean();
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   typename MedianFilterBank<T, K, N>::square_t MedianFilterBank<T, K, N>::getVariance(size_t channel)
+   {
+      return moments[channel].variance();
+   }
+
+
+   template <typename T, size_t K, size_t N>
+   T MedianFilterBank<T, K, N>::getStDev(size_t channel)
+   {
+      return moments[channel].stDev();
+   }
+
+#endif
@@ -0,0 +1,301 @@
+/*
+   MedianHeapFilter - running median over long windows, for the Arduino platform.
+
+   The same interface as MedianFilter, but the window is kept as two heaps
+   that meet at the median: a max-heap of the samples below it and a
+   min-heap of those above. A new sample overwrites the oldest in place and
+   is sifted through its heap, crossing the median at most once, so in()
+   is O(log n) where MedianFilter shifts O(n) entries. The median itself is
+   the heaps' common root and out() is O(1).
+
+   getMin() and getMax() scan the leaves of one heap, O(n / 2). The heaps
+   aren't sorted, so there is no getRank(), getPercentile() or getIqr(). The window
+   is always full, seeded like MedianFilter, so nothing changes size.
+
+   The heaps are addressed by a signed position: 0 is the median, 1, 2 ..
+   the min-heap (children of i at 2i, 2i + 1) and -1, -2 .. the max-heap
+   (children of i at 2i, 2i - 1). The parent of either side is i / 2.
+
+   For short windows the plain insertion sort of MedianFilter is quicker;
+   tools/median_bench measures where the two cross, AutoMedianFilter picks
+   between them at compile time.
+ */
+
+#ifndef MedianHeapFilter_h
+
+   #define MedianHeapFilter_h
+
+   #include "MedianFilter.h"
+
+   #define MEDIAN_HEAP_CROSSOVER 31   // windows above this use MedianHeapFilter
+
+   template <typename T, size_t N>
+   class MedianHeapFilter
+   {
+      static_assert(N >= 3, "MedianHeapFilter window must be at least 3");
+
+      public:
+         typedef typename MedianFilterIndex<N>::type index_t;
+         typedef typename MedianFilterTraits<T>::square_t square_t;
+         typedef typename std::conditional<(N < 0x8000), int16_t, int32_t>::type position_t;
+
+         MedianHeapFilter(T seed = T());
+         T in(const T & value);
+         T out();
+         void reset(T seed);
+         void shift(T delta);
+
+         T getMin();
+         T getMax();
+         T getMean();
+         square_t getVariance();
+         T getStDev();
+
+      private:
+         static const position_t maxCount = N >> 1;        // samples below the median
+         static const position_t minCount = (N - 1) >> 1;  // samples above it
+         std::array<T, N>          data;       // samples in arrival order, a ring buffer
+         std::array<index_t, N>    heap;       // ring slots by heap position, offset by maxCount
+         std::array<position_t, N> position;   // heap position of each ring slot
+         index_t oldestDataPoint;              // next ring slot to overwrite
+         MedianFilterMoments<T, N> moments;
+
+         bool less(position_t i, position_t j);
+         void exchange(position_t i, position_t j);
+         bool minSortUp(position_t i);
+         bool maxSortUp(position_t i);
+         void minSortDown(position_t i);
+         void maxSortDown(position_t i);
+   };
+
+
+   // AutoMedianFilter<T, N> is whichever engine is quicker for a window of N
+   template <typename T, size_t N>
+   using AutoMedianFilter = typename std::conditional<(N > MEDIAN_HEAP_CROSSOVER),
+                            MedianHeapFilter<T, N>, MedianFilter<T, N> >::type;
+
+
+   template <typename T, size_t N>
+   MedianHeapFilter<T, N>::MedianHeapFilter(T seed)
+   {
+      reset(seed);
+   }
+
+
+   template <typename T, size_t N>
+   void MedianHeapFilter<T, N>::reset(T seed)  // refill the window with the seed value
+   {
+      oldestDataPoint = 0;
+      moments.reset(seed);
+
+      for(size_t i = 0; i < N; i++)  // slots go 0, -1, 1, -2, 2 .. filling both heaps evenly
+      {
+         position_t p = position_t((i + 1) >> 1);
+         if(i & 1) p = -p;
+
+         data[i]            = seed;
+         position[i]        = p;
+         heap[p + maxCount] = i;
+      }
+   }
+
+
+   template <typename T, size_t N>
+   void MedianHeapFilter<T, N>::shift(T delta)  // add delta to every sample, the order doesn't change
+   {
+      for(size_t i = 0; i < N; i++)
+      {
+         data[i] += delta;
+      }
+
+      moments.shift(delta);
+   }
+
+
+   template <typename T, size_t N>
+   T MedianHeapFilter<T, N>::in(const T & value)
+   {
+      position_t p = position[oldestDataPoint];
+      T old = data[oldestDataPoint];
+
+      moments.replace(old, value);
+      data[oldestDataPoint] = value;
+
+      oldestDataPoint++;       // increment and wrap
+      if(oldestDataPoint == N) oldestDataPoint = 0;
+
+      if(p > 0)   // in the min-heap
+      {
+         if(old < value)
+         {
+            minSortDown(p);
+         }
+         else if(minSortUp(p) && less(0, -1))   // became the median, may belong below it
+         {
+            exchange(0, -1);
+            maxSortDown(-1);
+         }
+      }
+      else if(p < 0)   // in the max-heap
+      {
+         if(value < old)
+         {
+            maxSortDown(p);
+         }
+         else if(maxSortUp(p) && less(1, 0))
+         {
+            exchange(1, 0);
+            minSortDown(1);
+         }
+      }
+      else   // replaced the median
+      {
+         if(less(0, -1))
+         {
+            exchange(0, -1);
+            maxSortDown(-1);
+         }
+         else if(less(1, 0))
+         {
+            exchange(1, 0);
+            minSortDown(1);
+         }
+      }
+
+      return data[heap[maxCount]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianHeapFilter<T, N>::out() // return the value of the median data sample
+   {
+      return data[heap[maxCount]];
+   }
+
+
+   template <typename T, size_t N>
+   T MedianHeapFilter<T, N>::getMin()  // smallest leaf of the max-heap
+   {
+      T smallest = data[heap[0]];   // position -maxCount, always a leaf
+
+      for(position_t i = -maxCount + 1; i <= -(maxCount >> 1) - 1; i++)
+      {
+         T candidate = data[heap[i + maxCount]];
+         if(candidate < smallest) smallest = candidate;
+      }
+
+      return smallest;
+   }
+
+
+   template <typename T, size_t N>
+   T MedianHeapFilter<T, N>::getMax()  // largest leaf of the min-heap
+   {
+      T largest = data[heap[N - 1]];   // position minCount, always a leaf
+
+      for(position_t i = (minCount >> 1) + 1; i < minCount; i++)
+      {
+         T candidate = data[heap[i + maxCount]];
+         if(largest < candidate) largest = candidate;
+      }
+
+      return largest;
+   }
+
+
+   template <typename T, size_t N>
+   T MedianHeapFilter<T, N>::getMean()
+   {
+      return moments.mean();
+   }
+
+
+   template <typename T, size_t N>
+   typename MedianHeapFilter<T, N>::square_t MedianHeapFilter<T, N>::getVariance()
+   {
+      return moments.variance();
+   }
+
+
+   template <typename T, size_t N>
+   T MedianHeapFilter<T, N>::getStDev()
+   {
+      return moments.stDev();
+   }
+
+
+   template <typename T, size_t N>
+   bool MedianHeapFilter<T, N>::less(position_t i, position_t j)  // sample at heap position i < sample at j
+   {
+      return data[heap[i + maxCount]] < data[heap[j + maxCount]];
+   }
+
+
+   template <typename T, size_t N>
+   void MedianHeapFilter<T, N>::exchange(position_t i, position_t j)
+   {
+      index_t slot        = heap[i + maxCount];
+      heap[i + maxCount]  = heap[j + maxCount];
+      heap[j + maxCount]  = slot;
+
+      position[heap[i + maxCount]] = i;
+      position[heap[j + maxCount]] = j;
+   }
+
+
+   template <typename T, size_t N>
+   bool MedianHeapFilter<T, N>::minSortUp(position_t i)  // true if it reached the median
+   {
+      while(i > 0 && less(i, i / 2))
+      {
+         exchange(i, i / 2);
+         i /= 2;
+      }
+
+      return i == 0;
+   }
+
+
+   template <typename T, size_t N>
+   bool MedianHeapFilter<T, N>::maxSortUp(position_t i)  // true if it reached the median
+   {
+      while(i < 0 && less(i / 2, i))
+      {
+         exchange(i / 2, i);
+         i /= 2;
+      }
+
+      return i == 0;
+   }
+
+
+   template <typename T, size_t N>
+   void MedianHeapFilter<T, N>::minSortDown(position_t i)
+   {
+      for(position_t child = i * 2; child <= minCount; child = i * 2)
+      {
+         if(child < minCount && less(child + 1, child)) child++;   // smaller child
+
+         if(!less(child, i)) break;
+
+         exchange(child, i);
+         i = child;
+      }
+   }
+
+
+   template <typename T, size_t N>
+   void MedianHeapFilter<T, N>::maxSortDown(position_t i)
+   {
+      for(position_t child = i * 2; child >= -maxCount; child = i * 2)
+      {
+         if(child > -maxCount && less(child, child - 1)) child--;   // larger child
+
+         if(!less(i, child)) break;
+
+         exchange(child, i);
+         i = child;
+      }
+   }
+
+#endif
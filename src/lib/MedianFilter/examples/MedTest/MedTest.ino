@@ -1,7 +1,7 @@
 //#include <Arduino.h>
 #include <MedianFilter.h>
 
-MedianFilter test(31, 0);
+MedianFilter<int, 31> test(0);
 
 int i=0;
 int j;
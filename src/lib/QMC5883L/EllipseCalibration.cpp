@@ -0,0 +1,179 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EllipseCalibration.h"
+
+EllipseCalibration::EllipseCalibration()
+{
+  reset();
+}
+
+void EllipseCalibration::reset()
+{
+  memset(sums,0,sizeof(sums));
+  weight = 0;
+  taken = 0;
+  lastX = lastY = 0;
+  xlow = ylow = 32767;
+  xhigh = yhigh = -32768;
+  octants = 0;
+  fitted = false;
+  x0 = y0 = 0;
+  m[0] = m[3] = 1<<ELLIPSE_Q;
+  m[1] = m[2] = 0;
+}
+
+/* one sample into the normal equations, false if it was too close to the last */
+bool EllipseCalibration::add( int16_t x, int16_t y )
+{
+  if(taken > 0 && abs(x-lastX)+abs(y-lastY) < ELLIPSE_MIN_STEP) return false;
+
+  lastX = x;
+  lastY = y;
+  taken++;
+
+  if(x<xlow) xlow = x;
+  if(x>xhigh) xhigh = x;
+  if(y<ylow) ylow = y;
+  if(y>yhigh) yhigh = y;
+
+  int32_t dx = (int32_t)x - (xhigh+xlow)/2;
+  int32_t dy = (int32_t)y - (yhigh+ylow)/2;
+  octants |= 1 << ((dx<0)*4 + (dy<0)*2 + (abs(dx)<abs(dy)));
+
+  if(weight >= ELLIPSE_MAX_WEIGHT) {
+    for(int r=0;r<5;r++) for(int c=r;c<6;c++) sums[r][c] *= 0.5;
+    weight *= 0.5;
+  }
+
+  double fx = x/ELLIPSE_SCALE;
+  double fy = y/ELLIPSE_SCALE;
+  double v[5] = { fx*fx, fx*fy, fy*fy, fx, fy };
+
+  /* upper triangle only, solve() mirrors it */
+  for(int r=0;r<5;r++) {
+    for(int c=r;c<5;c++) sums[r][c] += v[r]*v[c];
+    sums[r][5] += v[r];
+  }
+  weight += 1;
+
+  return true;
+}
+
+/*
+ * Fits the conic and, if it is a sensible ellipse, makes it the calibration.
+ * Returns whether there is a fitted calibration. Costs a 5x5 elimination,
+ * so call it every so many samples rather than every sample.
+ */
+bool EllipseCalibration::solve()
+{
+  if(taken < ELLIPSE_MIN_SAMPLES || octants != 0xFF) return fitted;
+
+  double a[5][6];
+
+  for(int r=0;r<5;r++) {
+    for(int c=0;c<5;c++) a[r][c] = c>=r ? sums[r][c] : sums[c][r];
+    a[r][5] = sums[r][5];
+  }
+
+  /* gaussian elimination with partial pivoting */
+  for(int col=0;col<5;col++) {
+    int pivot = col;
+    for(int r=col+1;r<5;r++) if(fabs(a[r][col]) > fabs(a[pivot][col])) pivot = r;
+    if(fabs(a[pivot][col]) < 1e-12) return fitted;
+
+    if(pivot != col) {
+      for(int c=0;c<6;c++) {
+        double t = a[col][c];
+        a[col][c] = a[pivot][c];
+        a[pivot][c] = t;
+      }
+    }
+
+    for(int r=col+1;r<5;r++) {
+      double f = a[r][col]/a[col][col];
+      for(int c=col;c<6;c++) a[r][c] -= f*a[col][c];
+    }
+  }
+
+  double p[5];
+  for(int r=4;r>=0;r--) {
+    double s = a[r][5];
+    for(int c=r+1;c<5;c++) s -= a[r][c]*p[c];
+    p[r] = s/a[r][r];
+  }
+
+  /* with the origin outside the ellipse the conic comes out negated */
+  double sign = p[0] < 0 ? -1 : 1;
+  double A = sign*p[0], B = sign*p[1], C = sign*p[2], D = sign*p[3], E = sign*p[4];
+  double det = 4*A*C - B*B;
+
+  if(A <= 0 || C <= 0 || det <= 0) return fitted;
+
+  /* centre, where the gradient of the conic is zero */
+  double cx = (B*E - 2*C*D)/det;
+  double cy = (B*D - 2*A*E)/det;
+
+  /* quadratic form Q = [A B/2; B/2 C], its eigenvalues give the axis ratio */
+  double q01 = B/2;
+  double mean = (A+C)/2;
+  double spread = sqrt((A-C)*(A-C)/4 + q01*q01);
+  double low = mean-spread, high = mean+spread;
+
+  if(low <= 0 || high > low*ELLIPSE_MAX_AXIS_RATIO*ELLIPSE_MAX_AXIS_RATIO) return fitted;
+
+  /* symmetric square root of Q: (Q + sqrt(det Q) I)/sqrt(trace Q + 2 sqrt(det Q)) */
+  double s = sqrt(A*C - q01*q01);
+  double t = sqrt(A + C + 2*s);
+  double w[4] = { (A+s)/t, q01/t, q01/t, (C+s)/t };
+
+  /* only the direction of the result matters, largest entry becomes 1.0 */
+  double biggest = 0;
+  for(int i=0;i<4;i++) if(fabs(w[i]) > biggest) biggest = fabs(w[i]);
+
+  double centreX = cx*ELLIPSE_SCALE, centreY = cy*ELLIPSE_SCALE;
+  if(fabs(centreX) > 32767 || fabs(centreY) > 32767) return fitted;
+
+  x0 = (int16_t)lround(centreX);
+  y0 = (int16_t)lround(centreY);
+  for(int i=0;i<4;i++) m[i] = (int16_t)lround(w[i]/biggest*(1<<ELLIPSE_Q));
+  fitted = true;
+
+  return fitted;
+}
+
+bool EllipseCalibration::valid()
+{
+  return fitted;
+}
+
+uint32_t EllipseCalibration::samples()
+{
+  return taken;
+}
+
+/* a raw sample mapped onto a circle, in integer arithmetic */
+void EllipseCalibration::apply( int16_t x, int16_t y, int32_t *u, int32_t *v )
+{
+  int32_t dx = (int32_t)x - x0;
+  int32_t dy = (int32_t)y - y0;
+
+  *u = (m[0]*dx + m[1]*dy) >> ELLIPSE_Q;
+  *v = (m[2]*dx + m[3]*dy) >> ELLIPSE_Q;
+}
+
+void EllipseCalibration::get( int16_t *x0, int16_t *y0, int16_t m[4] )
+{
+  *x0 = this->x0;
+  *y0 = this->y0;
+  for(int i=0;i<4;i++) m[i] = this->m[i];
+}
+
+/* restores a saved fit, new samples refine it from scratch */
+void EllipseCalibration::set( int16_t x0, int16_t y0, const int16_t m[4] )
+{
+  this->x0 = x0;
+  this->y0 = y0;
+  for(int i=0;i<4;i++) this->m[i] = m[i];
+  fitted = true;
+}
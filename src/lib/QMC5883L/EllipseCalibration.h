@@ -0,0 +1,63 @@
+#ifndef ELLIPSE_CALIBRATION_H
+#define ELLIPSE_CALIBRATION_H
+
+#include <stdint.h>
+
+/*
+ * Hard and soft iron calibration from a least squares ellipse fit.
+ *
+ * Turning in a level plane, the x,y field traces an ellipse: shifted by hard
+ * iron, stretched and rotated by soft iron. Each sample adds its monomials to
+ * the normal equations of the conic
+ *
+ *   A x^2 + B xy + C y^2 + D x + E y = 1
+ *
+ * so memory is fixed and no samples are kept. solve() fits the conic and
+ * turns it into an integer offset and a Q12 2x2 matrix, the symmetric
+ * square root of the conic's quadratic form, that maps the ellipse back to
+ * a circle. apply() is then two subtractions and four multiplies per read.
+ *
+ * A fit is only tried once samples have been seen in all eight octants
+ * around the centre of their bounds, so a partial arc isn't taken for an
+ * ellipse. Samples within ELLIPSE_MIN_STEP of the last one taken are skipped so a
+ * parked car doesn't swamp the fit, and the sums are halved when their
+ * weight passes ELLIPSE_MAX_WEIGHT, which slowly forgets old samples.
+ */
+
+#define ELLIPSE_MIN_STEP 16      /* counts, |dx|+|dy| */
+#define ELLIPSE_MIN_SAMPLES 32   /* taken samples before a fit is tried */
+#define ELLIPSE_MAX_WEIGHT 4096
+#define ELLIPSE_MAX_AXIS_RATIO 4 /* a flatter fit is a partial arc, not an ellipse */
+#define ELLIPSE_SCALE 1024.0     /* raw counts per fit unit, keeps the sums well conditioned */
+#define ELLIPSE_Q 12
+#define ELLIPSE_SOLVE_EVERY 32  /* taken samples between fits */
+
+class EllipseCalibration {
+public:
+  EllipseCalibration();
+
+  void reset();
+  bool add( int16_t x, int16_t y );
+  bool solve();
+
+  bool valid();
+  uint32_t samples();
+  void apply( int16_t x, int16_t y, int32_t *u, int32_t *v );
+
+  /* the fitted calibration, to save and restore */
+  void get( int16_t *x0, int16_t *y0, int16_t m[4] );
+  void set( int16_t x0, int16_t y0, const int16_t m[4] );
+
+private:
+  double sums[5][6];   /* normal equations, [row][column], column 5 is the right hand side */
+  double weight;
+  uint32_t taken;
+  int16_t lastX, lastY;
+  int16_t xlow, xhigh, ylow, yhigh;
+  uint8_t octants;     /* bit per octant seen */
+  bool fitted;
+  int16_t x0, y0;      /* centre in raw counts */
+  int16_t m[4];        /* row major Q12 */
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef FAST_ATAN2_H
+#define FAST_ATAN2_H
+
+#include <stdint.h>
+
+/*
+ * atan2(y,x) in tenths of a degree, 0 to 3599, in integer arithmetic.
+ *
+ * The angle is folded into the first octant, where atan(r) for r = min/max
+ * in Q15 is approximated by
+ *
+ *   pi/4*r + r*(1-r)*(0.2447 + 0.0663*r)    (radians)
+ *
+ * and unfolded again. That costs one integer division and a handful of
+ * multiplies. The polynomial is within 0.09 degrees of atan and the result
+ * is rounded to the nearest tenth, so it is within 0.15 degrees of atan2.
+ * tools/atan2_bench checks that for every int16 input and for random
+ * int32 products as computeHeading passes in. atan2(0,0) is 0.
+ */
+inline int fastAtan2Tenths( int32_t y, int32_t x )
+{
+  uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+  uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+
+  uint32_t hi = ax > ay ? ax : ay;
+  uint32_t lo = ax > ay ? ay : ax;
+
+  if(hi == 0) return 0;
+
+  /* keep lo<<15 inside 32 bits, the ratio hardly changes */
+  while(hi > 0xFFFF) {
+    hi >>= 1;
+    lo >>= 1;
+  }
+
+  int32_t r = (lo << 15) / hi;   /* Q15, 0 to 1 */
+
+  /* first octant in hundredths of a degree: 4500 is pi/4, 1402 is 0.2447
+     and 380 is 0.0663 radians */
+  int32_t c = 1402 + ((380 * r) >> 15);
+  int32_t a = (r * (4500 + (((32768 - r) * c) >> 15))) >> 15;
+
+  int angle = (a + 5) / 10;
+
+  if(ay > ax) angle = 900 - angle;
+  if(x < 0) angle = 1800 - angle;
+  if(y < 0) angle = 3600 - angle;
+  if(angle >= 3600) angle -= 3600;
+
+  return angle;
+}
+
+#endif
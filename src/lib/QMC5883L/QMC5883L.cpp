@@ -1,6 +1,6 @@
 #include <Wire.h>
-#include <math.h>
 #include "QMC5883L.h"
+#include "FastAtan2.h"
 
 /*
  * QMC5883L
@@ -26,10 +26,7 @@
 #define QMC5883L_RESERVED 12
 #define QMC5883L_CHIP_ID 13
 
-/* Bit values for the STATUS register */
-#define QMC5883L_STATUS_DRDY 1
-#define QMC5883L_STATUS_OVL 2
-#define QMC5883L_STATUS_DOR 4
+/* Bit values for the STATUS register are in QMC5883L.h */
 
 /* Oversampling values for the CONFIG register */
 #define QMC5883L_CONFIG_OS512 0b00000000
@@ -47,15 +44,15 @@
 #define QMC5883L_CONFIG_100HZ  0b00001000
 #define QMC5883L_CONFIG_200HZ  0b00001100
 
+/* Bit values for the CONFIG2 register */
+#define QMC5883L_CONFIG2_INT_DISABLE 0b00000001
+#define QMC5883L_CONFIG2_ROL_PNT     0b01000000
+#define QMC5883L_CONFIG2_SOFT_RST    0b10000000
+
 /* Mode values for the CONFIG register */
 #define QMC5883L_CONFIG_STANDBY 0b00000000
 #define QMC5883L_CONFIG_CONT    0b00000001
 
-/* Apparently M_PI isn't available in all environments. */
-#ifndef M_PI
-#define M_PI 3.14159265358979323846264338327950288
-#endif
-
 static void write_register( int addr, int reg, int value )
 {
   Wire.beginTransmission(addr);
@@ -139,6 +136,18 @@ void QMC5883L::setSamplingRate( int x )
   reconfig();
 }
 
+/* Drive the DRDY pin high when new data is ready, it is enabled after reset. */
+void QMC5883L::setInterrupt( int enabled )
+{
+  write_register(addr,QMC5883L_CONFIG2,enabled ? 0 : QMC5883L_CONFIG2_INT_DISABLE);
+}
+
+/* The calibration starts empty, init() leaves it alone so it survives a reset. */
+QMC5883L::QMC5883L()
+{
+  resetCalibration();
+}
+
 void QMC5883L::init() {
   /* This assumes the wire library has been initialized. */
   addr = QMC5883L_ADDR;
@@ -156,15 +165,44 @@ int QMC5883L::ready()
   return status & QMC5883L_STATUS_DRDY; 
 }
 
-int QMC5883L::readRaw( int16_t *x, int16_t *y, int16_t *z, int16_t *t )
+/*
+ * Reads STATUS, then data and temperature (0x00-0x08) in one burst if
+ * there is a new sample. STATUS has to come first, reading any data
+ * register clears DRDY and DOR. Returns 0 when there is no new sample,
+ * otherwise the STATUS bits: DRDY, OVL when the field was out of range,
+ * DOR when samples were missed since the last read. The outputs are only
+ * written when there is a new sample.
+ */
+int QMC5883L::tryRead( int16_t *x, int16_t *y, int16_t *z, int16_t *t )
 {
-  while(!ready()) {}
+  uint8_t data[9];
 
-  if(!read_register(addr,QMC5883L_X_LSB,6)) return 0;
+  if(!read_register(addr,QMC5883L_STATUS,1)) return 0;
 
-  *x = Wire.read() | (Wire.read()<<8);
-  *y = Wire.read() | (Wire.read()<<8);
-  *z = Wire.read() | (Wire.read()<<8);
+  uint8_t status = Wire.read();
+  if(!(status & QMC5883L_STATUS_DRDY)) return 0;
+
+  if(!read_register(addr,QMC5883L_X_LSB,9)) return 0;
+
+  for(int i=0;i<9;i++) data[i] = Wire.read();
+
+  *x = data[QMC5883L_X_LSB] | (data[QMC5883L_X_MSB]<<8);
+  *y = data[QMC5883L_Y_LSB] | (data[QMC5883L_Y_MSB]<<8);
+  *z = data[QMC5883L_Z_LSB] | (data[QMC5883L_Z_MSB]<<8);
+  *t = data[QMC5883L_TEMP_LSB] | (data[QMC5883L_TEMP_MSB]<<8);
+
+  return status & (QMC5883L_STATUS_DRDY|QMC5883L_STATUS_OVL|QMC5883L_STATUS_DOR);
+}
+
+/* Waits up to QMC5883L_READ_TIMEOUT_MS for a sample, 0 if none came. */
+int QMC5883L::readRaw( int16_t *x, int16_t *y, int16_t *z, int16_t *t )
+{
+  unsigned long started = millis();
+
+  while(!tryRead(x,y,z,t)) {
+    if(millis()-started > QMC5883L_READ_TIMEOUT_MS) return 0;
+    yield();
+  }
 
   return 1;
 }
@@ -172,6 +210,36 @@ int QMC5883L::readRaw( int16_t *x, int16_t *y, int16_t *z, int16_t *t )
 void QMC5883L::resetCalibration() {
   xhigh = yhigh = 0;
   xlow = ylow = 0;
+  ellipse.reset();
+}
+
+/* Restore boundaries saved from getCalibration, headings are valid straight away. */
+void QMC5883L::setCalibration( int16_t xlow, int16_t xhigh, int16_t ylow, int16_t yhigh )
+{
+  this->xlow = xlow;
+  this->xhigh = xhigh;
+  this->ylow = ylow;
+  this->yhigh = yhigh;
+}
+
+void QMC5883L::getCalibration( int16_t *xlow, int16_t *xhigh, int16_t *ylow, int16_t *yhigh )
+{
+  *xlow = this->xlow;
+  *xhigh = this->xhigh;
+  *ylow = this->ylow;
+  *yhigh = this->yhigh;
+}
+
+/* The ellipse fit, false until there is one. */
+bool QMC5883L::getEllipse( int16_t *x0, int16_t *y0, int16_t m[4] )
+{
+  ellipse.get(x0,y0,m);
+  return ellipse.valid();
+}
+
+void QMC5883L::setEllipse( int16_t x0, int16_t y0, const int16_t m[4] )
+{
+  ellipse.set(x0,y0,m);
 }
 
 int QMC5883L::readHeading()
@@ -180,6 +248,12 @@ int QMC5883L::readHeading()
 
   if(!readRaw(&x,&y,&z,&t)) return 0;
 
+  return computeHeading(x,y);
+}
+
+/* Heading of a sample from readRaw or tryRead, refining the calibration. */
+int QMC5883L::computeHeading( int16_t x, int16_t y )
+{
   /* Update the observed boundaries of the measurements */
 
   if(x<xlow) xlow = x;
@@ -187,6 +261,20 @@ int QMC5883L::readHeading()
   if(y<ylow) ylow = y;
   if(y>yhigh) yhigh = y;
 
+  /* Refine the ellipse fit now and then, use it once there is one. */
+
+  if(ellipse.add(x,y) && ellipse.samples()%ELLIPSE_SOLVE_EVERY == 0) ellipse.solve();
+
+  if(ellipse.valid()) {
+    int32_t u, v;
+    ellipse.apply(x,y,&u,&v);
+
+    int heading = (fastAtan2Tenths(v,u)+5)/10;
+    if(heading<=0) heading += 360;
+
+    return heading;
+  }
+
   /* Bail out if not enough data is available. */
   
   if( xlow==xhigh || ylow==yhigh ) return 0;
@@ -196,12 +284,14 @@ int QMC5883L::readHeading()
   x -= (xhigh+xlow)/2;
   y -= (yhigh+ylow)/2;
 
-  /* Rescale the measurement to the range observed. */
-  
-  float fx = (float)x/(xhigh-xlow);
-  float fy = (float)y/(yhigh-ylow);
+  /* Rescale the measurement to the range observed. atan2(y/yrange,x/xrange)
+     is atan2(y*xrange,x*yrange), which needs no division and fits in 32 bits
+     as |x| and |y| are at most half their range. */
+
+  int32_t fx = (int32_t)x*(yhigh-ylow);
+  int32_t fy = (int32_t)y*(xhigh-xlow);
 
-  int heading = 180.0*atan2(fy,fx)/M_PI;
+  int heading = (fastAtan2Tenths(fy,fx)+5)/10;
   if(heading<=0) heading += 360;
   
   return heading;
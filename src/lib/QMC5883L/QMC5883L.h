@@ -1,8 +1,20 @@
 #ifndef QMC5883L_H
 #define QMC5883L_H
 
+#include "EllipseCalibration.h"
+
+/* Bits returned by tryRead, as the STATUS register. 0 is no new data. */
+#define QMC5883L_STATUS_DRDY 1
+#define QMC5883L_STATUS_OVL 2
+#define QMC5883L_STATUS_DOR 4
+
+/* How long readRaw waits for a sample, longer than the 10Hz period. */
+#define QMC5883L_READ_TIMEOUT_MS 120
+
 class QMC5883L {
 public:
+  QMC5883L();
+
   void init();
   void reset();
   int  ready();
@@ -10,16 +22,24 @@ public:
   
   int readHeading();
   int readRaw( int16_t *x, int16_t *y, int16_t *z, int16_t *t );
+  int tryRead( int16_t *x, int16_t *y, int16_t *z, int16_t *t );
+  int computeHeading( int16_t x, int16_t y );
 
   void resetCalibration();
+  void setCalibration( int16_t xlow, int16_t xhigh, int16_t ylow, int16_t yhigh );
+  void getCalibration( int16_t *xlow, int16_t *xhigh, int16_t *ylow, int16_t *yhigh );
+  bool getEllipse( int16_t *x0, int16_t *y0, int16_t m[4] );
+  void setEllipse( int16_t x0, int16_t y0, const int16_t m[4] );
 
   void setSamplingRate( int rate );
   void setRange( int range );
   void setOversampling( int ovl );
+  void setInterrupt( int enabled );
   
 private:
   int16_t xhigh, xlow;
   int16_t yhigh, ylow;
+  EllipseCalibration ellipse;
   uint8_t addr;
   uint8_t mode;
   uint8_t rate;
@@ -0,0 +1,100 @@
+#ifdef ATAN2_BENCHMARK
+
+#include "atan2Benchmark.h"
+#include <FastAtan2.h>
+
+static int16_t xs[ATAN2_BENCHMARK_SAMPLES];
+static int16_t ys[ATAN2_BENCHMARK_SAMPLES];
+
+// the same pseudo random field on every run, -2000 .. 2000
+static int16_t nextSample(uint32_t &state)
+{
+  state = state * 1103515245UL + 12345UL;
+  return (int16_t)((state >> 16) % 4001) - 2000;
+}
+
+// the heading as QMC5883L::readHeading computed it before, degrees
+static int floatHeading(int16_t x, int16_t y, int16_t xRange, int16_t yRange)
+{
+  float fx = (float)x / xRange;
+  float fy = (float)y / yRange;
+
+  int heading = 180.0 * atan2(fy, fx) / M_PI;
+  if (heading <= 0)
+  {
+    heading += 360;
+  }
+
+  return heading;
+}
+
+// the same through fastAtan2Tenths, as QMC5883L::computeHeading
+static int fixedHeading(int16_t x, int16_t y, int16_t xRange, int16_t yRange)
+{
+  int heading = (fastAtan2Tenths((int32_t)y * xRange, (int32_t)x * yRange) + 5) / 10;
+  if (heading <= 0)
+  {
+    heading += 360;
+  }
+
+  return heading;
+}
+
+// cycles for the whole batch, the least of a few runs so an interrupt
+// landing in one doesn't count
+static uint32_t timeHeadings(int (*heading)(int16_t, int16_t, int16_t, int16_t))
+{
+  uint32_t best = UINT32_MAX;
+  volatile int sink = 0;
+
+  for (int r = 0; r < ATAN2_BENCHMARK_RUNS; r++)
+  {
+    uint32_t started = ESP.getCycleCount();
+
+    for (int i = 0; i < ATAN2_BENCHMARK_SAMPLES; i++)
+    {
+      sink += heading(xs[i], ys[i], 4000, 3800);
+    }
+
+    uint32_t cycles = ESP.getCycleCount() - started;
+    if (cycles < best)
+    {
+      best = cycles;
+    }
+
+    yield();
+  }
+
+  return best;
+}
+
+static int emptyHeading(int16_t x, int16_t y, int16_t xRange, int16_t yRange)
+{
+  return x + y + xRange + yRange;
+}
+
+void atan2Benchmark()
+{
+  uint32_t state = 1;
+
+  for (int i = 0; i < ATAN2_BENCHMARK_SAMPLES; i++)
+  {
+    xs[i] = nextSample(state);
+    ys[i] = nextSample(state);
+  }
+
+  // the loop and the call through the pointer, taken off both
+  uint32_t overhead = timeHeadings(emptyHeading);
+  uint32_t floatCycles = timeHeadings(floatHeading) - overhead;
+  uint32_t fixedCycles = timeHeadings(fixedHeading) - overhead;
+
+  String msg = "float heading " + String(floatCycles / ATAN2_BENCHMARK_SAMPLES) + " cycles, fixed heading " + String(fixedCycles / ATAN2_BENCHMARK_SAMPLES) + " cycles, at " + String(ESP.getCpuFreqMHz()) + "MHz";
+  if (fixedCycles > 0)
+  {
+    msg += ", speedup " + String((float)floatCycles / fixedCycles);
+  }
+
+  Log(MQTT_ATAN2_BENCHMARK_TOPIC, msg.c_str());
+}
+
+#endif
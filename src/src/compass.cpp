@@ -1,8 +1,22 @@
 #include <Arduino.h>
+#include <EEPROM.h>
 #include "compass.h"
 
-Compass::Compass() : medianCompassHeadings(15, 0), sensor()
+#ifdef COMPASS_DRDY_PIN
+static volatile bool compassReady = false;
+static volatile unsigned long compassReadyAt = 0;
+
+static void ICACHE_RAM_ATTR compassInterrupt()
 {
+  compassReady = true;
+  compassReadyAt = micros();
+}
+#endif
+
+Compass::Compass() : sensor(), medianCompassHeadings(360), heading(0), headingTimestamp(0), samplesSinceStats(0), overruns(0), overflows(0), drdyTimeouts(0), statsSince(0), savedAt(0)
+{
+  memset(&saved, 0, sizeof(saved));
+
   Log("QMC5883L Compass");
 }
 
@@ -13,31 +27,255 @@ void Compass::Begin()
   sensor.init();
   sensor.setSamplingRate(100);
 
-  Log("Turn compass in all directions to calibrate....");
+  EEPROM.begin(sizeof(CompassCalibration));
 
-  //get an average to start with
-  for (int i = 0; i <= 20; i++)
+  if (loadCalibration() == true)
   {
-    int compassHeading = sensor.readHeading();
+    Log(MQTT_COMPASS_TOPIC, "Calibration loaded");
+  }
+  else
+  {
+    Log("Turn compass in all directions to calibrate....");
 
-    if (compassHeading == 0)
+    //get an average to start with
+    for (int i = 0; i <= 20; i++)
     {
-      // publish compass details to topic
-      Log(MQTT_COMPASS_TOPIC, "Still calibrating");
+      int compassHeading = sensor.readHeading();
+
+      if (compassHeading == 0)
+      {
+        // publish compass details to topic
+        Log(MQTT_COMPASS_TOPIC, "Still calibrating");
+      }
+      else
+      {
+        Log("Heading = " + String(compassHeading));
+      }
+
+      delay(10);
+      yield();
     }
-    else
+  }
+
+#ifdef COMPASS_DRDY_PIN
+  sensor.setInterrupt(1);
+  pinMode(COMPASS_DRDY_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(COMPASS_DRDY_PIN), compassInterrupt, RISING);
+
+  // DRDY is likely high already with a sample taken before the interrupt
+  // was attached, it only falls, and rises again, once that is read
+  int16_t x, y, z, t;
+  sensor.tryRead(&x, &y, &z, &t);
+  compassReadyAt = micros();
+#endif
+
+  // isLost counts from here
+  headingTimestamp = micros();
+}
+
+static uint8_t calibrationChecksum(const CompassCalibration &calibration)
+{
+  const uint8_t *bytes = (const uint8_t *)&calibration;
+  uint8_t sum = 0;
+
+  for (size_t i = 0; i < offsetof(CompassCalibration, checksum); i++)
+  {
+    sum = (sum << 1 | sum >> 7) ^ bytes[i];
+  }
+
+  return sum;
+}
+
+// the stored calibration if it is ours, intact and wide enough to use
+bool Compass::loadCalibration()
+{
+  EEPROM.get(COMPASS_CALIBRATION_ADDRESS, saved);
+
+  //older versions are dropped, the car calibrates again
+  if (saved.version != COMPASS_CALIBRATION_VERSION || saved.checksum != calibrationChecksum(saved))
+  {
+    memset(&saved, 0, sizeof(saved));
+    return false;
+  }
+
+  if (saved.xhigh - saved.xlow < COMPASS_CALIBRATION_MIN_RANGE || saved.yhigh - saved.ylow < COMPASS_CALIBRATION_MIN_RANGE)
+  {
+    return false;
+  }
+
+  sensor.setCalibration(saved.xlow, saved.xhigh, saved.ylow, saved.yhigh);
+
+  if (saved.hasEllipse)
+  {
+    sensor.setEllipse(saved.x0, saved.y0, saved.m);
+  }
+
+  savedAt = millis();
+
+  return true;
+}
+
+// true when the calibration has moved far enough from the saved one to be
+// worth a flash write
+static bool calibrationMoved(const CompassCalibration &current, const CompassCalibration &saved)
+{
+  if (current.version != saved.version || current.hasEllipse != saved.hasEllipse)
+  {
+    return true;
+  }
+
+  const int16_t counts[][2] = {{current.xlow, saved.xlow}, {current.xhigh, saved.xhigh}, {current.ylow, saved.ylow}, {current.yhigh, saved.yhigh}, {current.x0, saved.x0}, {current.y0, saved.y0}};
+
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+  {
+    if (abs(counts[i][0] - counts[i][1]) > COMPASS_CALIBRATION_SAVE_COUNTS)
     {
-      Log("Heading = " + String(compassHeading));
+      return true;
     }
+  }
+
+  long largest = 1;
+  for (int i = 0; i < 4; i++)
+  {
+    largest = max(largest, (long)abs(saved.m[i]));
+  }
+
+  for (int i = 0; i < 4; i++)
+  {
+    if (abs(current.m[i] - saved.m[i]) * 100L > largest * COMPASS_CALIBRATION_SAVE_PERCENT)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// writes the calibration when it has moved since the last save, flash
+// sectors wear out so not more than every COMPASS_CALIBRATION_SAVE_MS.
+// force skips both checks, it is still only written if it changed at all
+void Compass::saveCalibration(bool force)
+{
+  if (force == false && millis() - savedAt < COMPASS_CALIBRATION_SAVE_MS)
+  {
+    return;
+  }
+
+  CompassCalibration current;
+  memset(&current, 0, sizeof(current));
+  current.version = COMPASS_CALIBRATION_VERSION;
+  sensor.getCalibration(&current.xlow, &current.xhigh, &current.ylow, &current.yhigh);
+  current.hasEllipse = sensor.getEllipse(&current.x0, &current.y0, current.m);
+
+  if (current.xhigh - current.xlow < COMPASS_CALIBRATION_MIN_RANGE || current.yhigh - current.ylow < COMPASS_CALIBRATION_MIN_RANGE)
+  {
+    return;
+  }
+
+  if (memcmp(&current, &saved, offsetof(CompassCalibration, checksum)) == 0)
+  {
+    return;
+  }
 
-    delay(10);
-    yield();
+  if (force == false && calibrationMoved(current, saved) == false)
+  {
+    savedAt = millis(); // look again in a while
+    return;
   }
+
+  current.checksum = calibrationChecksum(current);
+
+  EEPROM.put(COMPASS_CALIBRATION_ADDRESS, current);
+
+  if (EEPROM.commit() == true)
+  {
+    saved = current;
+    Log(MQTT_COMPASS_TOPIC, ("Calibration saved x " + String(current.xlow) + ".." + String(current.xhigh) + " y " + String(current.ylow) + ".." + String(current.yhigh) + (current.hasEllipse ? " ellipse" : "")).c_str());
+  }
+
+  savedAt = millis();
+}
+
+// forget the calibration, {"command":"compass_recalibrate"} over MQTT.
+// the next save replaces the stored one
+void Compass::recalibrate()
+{
+  sensor.resetCalibration();
+  memset(&saved, 0, sizeof(saved));
+  savedAt = 0;
+
+  Log(MQTT_COMPASS_TOPIC, "Calibration reset, turn compass in all directions");
+}
+
+// write the calibration now, however little it moved, {"command":"compass_save"}
+// over MQTT, before switching off
+void Compass::save()
+{
+  saveCalibration(true);
+}
+
+// set the sensor up again after an I2C bus recovery, keeps the calibration
+void Compass::reinit()
+{
+  sensor.init();
+  sensor.setSamplingRate(100);
 }
 
+// one burst read of data and status, returns the last heading straight
+// away when the sensor has nothing new
 int Compass::Loop()
 {
-  int compassHeading = sensor.readHeading();
+  publishStats();
+
+#ifdef COMPASS_DRDY_PIN
+  // no new sample, don't touch the bus. unless no edge has come for a few
+  // sample periods: a read that failed leaves DRDY high and it never rises
+  // again, polling the sensor reads the sample and starts the edges again
+  bool edge = compassReady;
+
+  if (edge == false && micros() - compassReadyAt < COMPASS_DRDY_TIMEOUT_US)
+  {
+    return heading;
+  }
+
+  compassReady = false;
+  unsigned long sampledAt = edge == true ? compassReadyAt : micros();
+
+  if (edge == false)
+  {
+    compassReadyAt = sampledAt; // poll once per timeout, not every loop
+    drdyTimeouts++;
+  }
+#else
+  unsigned long sampledAt = micros();
+#endif
+
+  int16_t x, y, z, t;
+  int status = sensor.tryRead(&x, &y, &z, &t);
+
+  if (status == 0)
+  {
+    return heading;
+  }
+
+  headingTimestamp = sampledAt;
+  samplesSinceStats++;
+
+  if (status & QMC5883L_STATUS_DOR)
+  {
+    overruns++;
+  }
+
+  if (status & QMC5883L_STATUS_OVL)
+  {
+    // the field is out of range, the heading would be nonsense
+    overflows++;
+    return heading;
+  }
+
+  int compassHeading = sensor.computeHeading(x, y);
+
+  saveCalibration(false);
 
   if (compassHeading == 0)
   {    // publish compass details to topic
@@ -47,10 +285,64 @@ int Compass::Loop()
   {
     Log(MQTT_COMPASS_HEADING_TOPIC, String(compassHeading));
 
+    yawRate.add(compassHeading, headingTimestamp);
+
+    //1 to 360 like the raw headings, 0 means still calibrating
     compassHeading = medianCompassHeadings.in(compassHeading);
+    if (compassHeading == 0)
+    {
+      compassHeading = 360;
+    }
 
     Log(MQTT_COMPASS_MEDIAN_TOPIC, String(compassHeading));
   }
 
+  heading = compassHeading;
+
   return compassHeading;
 }
+
+unsigned long Compass::getTimestamp()
+{
+  return headingTimestamp;
+}
+
+// no new sample for COMPASS_LOST_US, the reads are failing
+bool Compass::isLost()
+{
+  return micros() - headingTimestamp > COMPASS_LOST_US;
+}
+
+// degrees per second, positive turning clockwise
+long Compass::getYawRate()
+{
+  return yawRate.degreesPerSecond();
+}
+
+// false until there are recent samples to work the yaw rate out from
+bool Compass::yawRateReady()
+{
+  return yawRate.ready() && micros() - headingTimestamp < YAW_RATE_MAX_GAP_US;
+}
+
+// sample rate, missed samples, overflows and yaw rate once a second
+void Compass::publishStats()
+{
+  unsigned long elapsed = millis() - statsSince;
+
+  if (elapsed < 1000)
+  {
+    return;
+  }
+
+  String msg = "rate " + String(samplesSinceStats * 1000 / elapsed) + "/s overruns " + String(overruns) + " overflows " + String(overflows) + " yaw " + String(getYawRate()) + "deg/s spread " + String(medianCompassHeadings.getIqr()) + "deg";
+
+#ifdef COMPASS_DRDY_PIN
+  msg += " drdy timeouts " + String(drdyTimeouts);
+#endif
+
+  Log(MQTT_COMPASS_STATS_TOPIC, msg.c_str());
+
+  samplesSinceStats = 0;
+  statsSince = millis();
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+#include "headingHold.h"
+
+// integral that gives the full trim on its own, anti-windup
+#define HEADING_HOLD_MAX_INTEGRAL ((int32_t)HEADING_HOLD_MAX_TRIM * 16 * 1000 / (HEADING_HOLD_KI != 0 ? abs(HEADING_HOLD_KI) : 1))
+
+HeadingHold::HeadingHold() : direction(HEADING_HOLD_OFF), target(0), integral(0), trim(0), nextStep(0), steppedTimestamp(0)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+// latches the heading when a new straight direction starts and releases it
+// when driving straight ends, 0 for a heading means none yet
+void HeadingHold::hold(uint8_t newDirection, int heading, unsigned long nowMillis)
+{
+  if (newDirection == HEADING_HOLD_OFF || heading == 0)
+  {
+    stop();
+    return;
+  }
+
+  if (newDirection != direction)
+  {
+    direction = newDirection;
+    target = heading;
+    integral = 0;
+    trim = 0;
+    nextStep = nowMillis;
+  }
+}
+
+// one PI step if one is due and the compass has read a heading since the
+// last one, true when the trim was updated. headingTimestamp tells the
+// compass samples apart
+bool HeadingHold::step(int heading, unsigned long headingTimestamp, unsigned long nowMillis)
+{
+  if (direction == HEADING_HOLD_OFF || heading == 0 || (long)(nowMillis - nextStep) < 0)
+  {
+    return false;
+  }
+
+  // stay on the grid, the periods already gone get no step of their own
+  unsigned long behind = (nowMillis - nextStep) / HEADING_HOLD_PERIOD_MS;
+  stats.missed += behind;
+  nextStep += (behind + 1) * HEADING_HOLD_PERIOD_MS;
+
+  if (headingTimestamp == steppedTimestamp)
+  {
+    stats.missed++;
+    return false;
+  }
+
+  steppedTimestamp = headingTimestamp;
+  run(heading);
+
+  return true;
+}
+
+// one PI step with a fixed dt of one period
+void HeadingHold::run(int heading)
+{
+  // -180..179, positive when we have turned anticlockwise of the target
+  int error = ((target - heading) % 360 + 540) % 360 - 180;
+
+  integral += (int32_t)error * HEADING_HOLD_PERIOD_MS;
+  if (integral > HEADING_HOLD_MAX_INTEGRAL)
+  {
+    integral = HEADING_HOLD_MAX_INTEGRAL;
+  }
+  else if (integral < -HEADING_HOLD_MAX_INTEGRAL)
+  {
+    integral = -HEADING_HOLD_MAX_INTEGRAL;
+  }
+
+  int32_t output = ((int32_t)HEADING_HOLD_KP * error + (int32_t)HEADING_HOLD_KI * integral / 1000) / 16;
+
+  if (output > HEADING_HOLD_MAX_TRIM)
+  {
+    output = HEADING_HOLD_MAX_TRIM;
+  }
+  else if (output < -HEADING_HOLD_MAX_TRIM)
+  {
+    output = -HEADING_HOLD_MAX_TRIM;
+  }
+
+  // reversing turns the car the other way for the same trim
+  trim = direction == HEADING_HOLD_SOUTH ? -output : output;
+
+  stats.steps++;
+  stats.errorSum += abs(error);
+  if (abs(error) > stats.errorMax)
+  {
+    stats.errorMax = abs(error);
+  }
+  stats.trim = trim;
+}
+
+void HeadingHold::stop()
+{
+  direction = HEADING_HOLD_OFF;
+  integral = 0;
+  trim = 0;
+}
+
+uint8_t HeadingHold::getDirection()
+{
+  return direction;
+}
+
+int HeadingHold::getTarget()
+{
+  return target;
+}
+
+// for the left side, the right gets the opposite
+int HeadingHold::getTrim()
+{
+  return trim;
+}
+
+// counters since the last call
+HeadingHoldStats HeadingHold::takeStats()
+{
+  HeadingHoldStats taken = stats;
+
+  memset(&stats, 0, sizeof(stats));
+  stats.trim = taken.trim;
+
+  return taken;
+}
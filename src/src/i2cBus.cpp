@@ -0,0 +1,503 @@
+#include <Arduino.h>
+#include "i2cBus.h"
+#include "LOLIN_I2C_MOTOR.h"
+
+// clocks tried by the validated profile and the benchmark, slowest first
+static const uint32_t candidateClocks[] = {100000, 200000, 300000, 400000};
+static const uint8_t candidateClockCount = sizeof(candidateClocks) / sizeof(candidateClocks[0]);
+
+static const int validationRuns = 3;
+static const int benchmarkRuns = 50;
+
+I2CBus::I2CBus() : clock(I2C_CLOCK_STANDARD), deviceCount(0), presence(0), recoveryHandlerCount(0), stuckChecks(0), recoveries(0), recoveryMicros(0)
+{
+  devices[deviceCount++] = {I2C_ADDRESS_LEFT_MOTORS, "left motors", 0};
+  devices[deviceCount++] = {I2C_ADDRESS_RIGHT_MOTORS, "right motors", 0};
+  devices[deviceCount++] = {I2C_ADDRESS_COMPASS, "compass", 0};
+  devices[deviceCount++] = {I2C_ADDRESS_LASER, "laser", 0};
+  devices[deviceCount++] = {I2C_ADDRESS_NUNCHUCK, "nunchuck", 0};
+}
+
+void I2CBus::Begin()
+{
+  Wire.begin();
+
+#if I2C_BUS_PROFILE == I2C_PROFILE_FAST
+  setClock(I2C_CLOCK_FAST);
+#elif I2C_BUS_PROFILE == I2C_PROFILE_VALIDATED
+  setClock(validate());
+#else
+  setClock(I2C_CLOCK_STANDARD);
+#endif
+
+  Log(MQTT_I2C_TOPIC, ("I2C clock " + String(clock) + "Hz").c_str());
+}
+
+void I2CBus::setClock(uint32_t newClock)
+{
+  clock = newClock;
+  Wire.setClock(clock);
+}
+
+uint32_t I2CBus::getClock()
+{
+  return clock;
+}
+
+// walk the candidate clocks and remember the highest one each device
+// still answers correctly at, the bus then runs at the slowest of those
+uint32_t I2CBus::validate()
+{
+  uint32_t busClock = 0;
+
+  for (uint8_t d = 0; d < deviceCount; d++)
+  {
+    devices[d].maxClock = 0;
+
+    for (uint8_t c = 0; c < candidateClockCount; c++)
+    {
+      yield();
+
+      Wire.setClock(candidateClocks[c]);
+
+      if (validateDevice(devices[d]) == false)
+      {
+        break;
+      }
+
+      devices[d].maxClock = candidateClocks[c];
+    }
+
+    if (devices[d].maxClock == 0)
+    {
+      // not on the bus, don't let it drag the clock down
+      continue;
+    }
+
+    Log(MQTT_I2C_TOPIC, (String(devices[d].name) + " validated to " + String(devices[d].maxClock) + "Hz").c_str());
+
+    if (busClock == 0 || devices[d].maxClock < busClock)
+    {
+      busClock = devices[d].maxClock;
+    }
+  }
+
+  if (busClock == 0)
+  {
+    busClock = I2C_CLOCK_STANDARD;
+  }
+
+  return busClock;
+}
+
+// read back something we know the answer to, a few times over
+bool I2CBus::validateDevice(const I2CDevice &device)
+{
+  for (int i = 0; i < validationRuns; i++)
+  {
+    uint8_t expected;
+    uint8_t reg;
+
+    switch (device.address)
+    {
+    case I2C_ADDRESS_LEFT_MOTORS:
+    case I2C_ADDRESS_RIGHT_MOTORS:
+      Wire.beginTransmission(device.address);
+      Wire.write((uint8_t)GET_SLAVE_STATUS);
+      if (Wire.endTransmission() != 0)
+      {
+        return false;
+      }
+      delay(50); // the shield needs time to answer, same as LOLIN_I2C_MOTOR::sendData
+      if (Wire.requestFrom(device.address, (uint8_t)2) != 2 || Wire.read() != PRODUCT_ID_I2C_MOTOR)
+      {
+        return false;
+      }
+      Wire.read();
+      continue;
+
+    case I2C_ADDRESS_NUNCHUCK:
+      // nothing fixed to read back, a full report has to arrive though
+      if (transaction(device.address) == false)
+      {
+        return false;
+      }
+      continue;
+
+    case I2C_ADDRESS_COMPASS:
+      reg = 0x0D; // chip id
+      expected = 0xFF;
+      break;
+
+    case I2C_ADDRESS_LASER:
+      reg = 0xC0; // model id
+      expected = 0xEE;
+      break;
+
+    default:
+      return false;
+    }
+
+    Wire.beginTransmission(device.address);
+    Wire.write(reg);
+    if (Wire.endTransmission() != 0)
+    {
+      return false;
+    }
+
+    if (Wire.requestFrom(device.address, (uint8_t)1) != 1 || Wire.read() != expected)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// the transaction each driver issues most often
+bool I2CBus::transaction(uint8_t address)
+{
+  uint8_t count = 0;
+
+  switch (address)
+  {
+  case I2C_ADDRESS_COMPASS:
+    // 6 byte data burst, as QMC5883L::readRaw
+    Wire.beginTransmission(address);
+    Wire.write((uint8_t)0x00);
+    if (Wire.endTransmission() != 0)
+    {
+      return false;
+    }
+    count = 6;
+    break;
+
+  case I2C_ADDRESS_NUNCHUCK:
+    // 6 byte report followed by the request for the next one, as Nunchuck::nunchuck_get_data
+    if (Wire.requestFrom(address, (uint8_t)6) != 6)
+    {
+      return false;
+    }
+    while (Wire.available())
+    {
+      Wire.read();
+    }
+    Wire.beginTransmission(address);
+    Wire.write((uint8_t)0x00);
+    return Wire.endTransmission() == 0;
+
+  case I2C_ADDRESS_LEFT_MOTORS:
+  case I2C_ADDRESS_RIGHT_MOTORS:
+    // stop command and its acknowledge byte, as LOLIN_I2C_MOTOR::changeStatus without the delay
+    Wire.beginTransmission(address);
+    Wire.write((uint8_t)CHANGE_STATUS);
+    Wire.write((uint8_t)MOTOR_CH_BOTH);
+    Wire.write((uint8_t)MOTOR_STATUS_STOP);
+    if (Wire.endTransmission() != 0)
+    {
+      return false;
+    }
+    count = 1;
+    break;
+
+  case I2C_ADDRESS_LASER:
+    // range status block read by the VL53L0X API for every measurement
+    Wire.beginTransmission(address);
+    Wire.write((uint8_t)0x14);
+    if (Wire.endTransmission() != 0)
+    {
+      return false;
+    }
+    count = 12;
+    break;
+
+  default:
+    return false;
+  }
+
+  if (Wire.requestFrom(address, count) != count)
+  {
+    return false;
+  }
+
+  while (Wire.available())
+  {
+    Wire.read();
+  }
+
+  return true;
+}
+
+// times the representative transaction of every device at every
+// candidate clock and reports the achievable rate, stops the motors
+void I2CBus::Benchmark()
+{
+  uint32_t bestClock = 0;
+  bool stable = true;
+
+  Log(MQTT_I2C_TOPIC, "I2C benchmark start");
+
+  for (uint8_t c = 0; c < candidateClockCount; c++)
+  {
+    Wire.setClock(candidateClocks[c]);
+
+    String msg = String(candidateClocks[c]) + "Hz";
+    int errors = 0;
+
+    for (uint8_t d = 0; d < deviceCount; d++)
+    {
+      int deviceErrors = 0;
+      unsigned long started = micros();
+
+      for (int i = 0; i < benchmarkRuns; i++)
+      {
+        if (transaction(devices[d].address) == false)
+        {
+          deviceErrors++;
+        }
+      }
+
+      unsigned long perTransaction = (micros() - started) / benchmarkRuns;
+
+      yield();
+
+      if (deviceErrors == benchmarkRuns)
+      {
+        msg += " " + String(devices[d].name) + " absent";
+        continue;
+      }
+
+      msg += " " + String(devices[d].name) + " " + String(perTransaction) + "us";
+      if (perTransaction > 0)
+      {
+        msg += " " + String(1000000UL / perTransaction) + "/s";
+      }
+      if (deviceErrors > 0)
+      {
+        msg += " " + String(deviceErrors) + " errors";
+      }
+
+      errors += deviceErrors;
+    }
+
+    Log(MQTT_I2C_TOPIC, msg.c_str());
+
+    // only count a clock as stable if every slower one was too
+    if (errors > 0)
+    {
+      stable = false;
+    }
+
+    if (stable == true)
+    {
+      bestClock = candidateClocks[c];
+    }
+  }
+
+  Wire.setClock(clock);
+
+  if (bestClock == 0)
+  {
+    Log(MQTT_I2C_TOPIC, "I2C benchmark: no clock was error free");
+  }
+  else
+  {
+    Log(MQTT_I2C_TOPIC, ("I2C benchmark: highest stable clock " + String(bestClock) + "Hz").c_str());
+  }
+}
+
+// the watchdog, call once per loop while no transaction is running.
+// returns true when the bus had locked up and has been recovered
+bool I2CBus::Loop()
+{
+  if (linesReleased() == true)
+  {
+    stuckChecks = 0;
+    return false;
+  }
+
+  stuckChecks++;
+
+  if (stuckChecks < I2C_STUCK_CHECKS)
+  {
+    return false;
+  }
+
+  stuckChecks = 0;
+
+  return recover();
+}
+
+// both lines float high through the pull ups when nobody is talking
+bool I2CBus::linesReleased()
+{
+  return digitalRead(SDA) == HIGH && digitalRead(SCL) == HIGH;
+}
+
+// clock out whatever a slave is still trying to send (at most 9 bits
+// with the ack), generate a stop, restart Wire and re-initialise the drivers
+bool I2CBus::recover()
+{
+  unsigned long started = micros();
+
+  // latch the outputs high first so switching the pins over doesn't glitch
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, OUTPUT_OPEN_DRAIN);
+
+  for (int i = 0; i < 9 && digitalRead(SDA) == LOW; i++)
+  {
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    digitalWrite(SCL, HIGH);
+    delayMicroseconds(5);
+  }
+
+  // stop condition, SDA rising while SCL is high. SDA only goes low while
+  // SCL is low, pulling it down with SCL high would be a start
+  digitalWrite(SCL, LOW);
+  delayMicroseconds(5);
+  pinMode(SDA, OUTPUT_OPEN_DRAIN);
+  digitalWrite(SDA, LOW);
+  delayMicroseconds(5);
+  digitalWrite(SCL, HIGH);
+  delayMicroseconds(5);
+  digitalWrite(SDA, HIGH);
+  delayMicroseconds(5);
+
+  // hand the pins back released, the core's I2C code pulls a line down by
+  // enabling its output and relies on the latch being low
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+  digitalWrite(SDA, LOW);
+  digitalWrite(SCL, LOW);
+
+  Wire.begin();
+  Wire.setClock(clock);
+
+  bool released = linesReleased();
+
+  if (released == true)
+  {
+    for (uint8_t i = 0; i < recoveryHandlerCount; i++)
+    {
+      recoveryHandlers[i]();
+    }
+  }
+
+  unsigned long took = micros() - started;
+
+  recoveries++;
+  recoveryMicros += took;
+
+  String msg = released == true ? "I2C bus recovered in " : "I2C bus still stuck after ";
+  msg += String(took) + "us, " + String(recoveries) + " recoveries " + String(recoveryMicros) + "us total";
+
+  Log(MQTT_I2C_TOPIC, msg.c_str());
+
+  return released;
+}
+
+// drivers that need to be set up again once the bus is back
+void I2CBus::onRecovery(std::function<void()> handler)
+{
+  if (recoveryHandlerCount < I2C_MAX_RECOVERY_HANDLERS)
+  {
+    recoveryHandlers[recoveryHandlerCount++] = handler;
+  }
+}
+
+static bool acknowledges(uint8_t address)
+{
+  Wire.beginTransmission(address);
+  return Wire.endTransmission() == 0;
+}
+
+// probe only the addresses we expect, once each, and publish the result
+// as a single message. returns the presence bitmap, bit n for devices[n]
+uint8_t I2CBus::discover()
+{
+  presence = 0;
+
+  for (uint8_t d = 0; d < deviceCount; d++)
+  {
+    if (acknowledges(devices[d].address) == true)
+    {
+      presence |= 1 << d;
+    }
+  }
+
+  String msg = "I2C devices 0x" + String(presence, HEX) + ":";
+
+  for (uint8_t d = 0; d < deviceCount; d++)
+  {
+    msg += " " + String(devices[d].name) + (presence & (1 << d) ? " ok" : " missing");
+  }
+
+  Log(MQTT_I2C_TOPIC, msg.c_str());
+
+  return presence;
+}
+
+bool I2CBus::present(uint8_t address)
+{
+  for (uint8_t d = 0; d < deviceCount; d++)
+  {
+    if (devices[d].address == address)
+    {
+      return (presence & (1 << d)) != 0;
+    }
+  }
+
+  return false;
+}
+
+// checks one expected device again and updates its presence bit
+bool I2CBus::probe(uint8_t address)
+{
+  for (uint8_t d = 0; d < deviceCount; d++)
+  {
+    if (devices[d].address == address)
+    {
+      if (acknowledges(address) == true)
+      {
+        presence |= 1 << d;
+      }
+      else
+      {
+        presence &= ~(1 << d);
+      }
+
+      return (presence & (1 << d)) != 0;
+    }
+  }
+
+  return false;
+}
+
+// diagnostic sweep of every address, {"command":"i2c_scan"} over MQTT
+void I2CBus::scan()
+{
+  String msg = "I2C scan:";
+  int nDevices = 0;
+
+  for (uint8_t address = 1; address < 127; address++)
+  {
+    yield();
+
+    if (acknowledges(address) == true)
+    {
+      msg += address < 16 ? " 0x0" : " 0x";
+      msg += String(address, HEX);
+      nDevices++;
+    }
+  }
+
+  if (nDevices == 0)
+  {
+    msg += " no devices found";
+  }
+
+  Log(MQTT_I2C_TOPIC, msg.c_str());
+}
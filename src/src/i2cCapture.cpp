@@ -0,0 +1,140 @@
+#ifdef I2C_CAPTURE
+
+#include <Arduino.h>
+#include "i2cCapture.h"
+
+// the real twi functions, renamed by -Wl,--wrap=twi_writeTo -Wl,--wrap=twi_readFrom
+extern "C" unsigned char __real_twi_writeTo(unsigned char address, unsigned char *buf, unsigned int len, unsigned char sendStop);
+extern "C" unsigned char __real_twi_readFrom(unsigned char address, unsigned char *buf, unsigned int len, unsigned char sendStop);
+
+extern "C" unsigned char __wrap_twi_writeTo(unsigned char address, unsigned char *buf, unsigned int len, unsigned char sendStop)
+{
+  unsigned long started = micros();
+  unsigned char result = __real_twi_writeTo(address, buf, len, sendStop);
+
+  i2cCapture.record(address, false, buf, len, result, started);
+
+  return result;
+}
+
+extern "C" unsigned char __wrap_twi_readFrom(unsigned char address, unsigned char *buf, unsigned int len, unsigned char sendStop)
+{
+  unsigned long started = micros();
+  unsigned char result = __real_twi_readFrom(address, buf, len, sendStop);
+
+  i2cCapture.record(address, true, buf, len, result, started);
+
+  return result;
+}
+
+I2CCapture::I2CCapture() : head(0), tail(0), used(0), records(0), dropped(0), lastMicros(0)
+{
+}
+
+void I2CCapture::record(uint8_t address, bool read, const uint8_t *data, unsigned int len, uint8_t result, unsigned long started)
+{
+  uint32_t delta = started - lastMicros;
+  lastMicros = started;
+
+  uint8_t kept = len < I2C_CAPTURE_MAX_DATA ? len : I2C_CAPTURE_MAX_DATA;
+
+  uint8_t varintLength = 1;
+  for (uint32_t v = delta >> 7; v != 0; v >>= 7)
+  {
+    varintLength++;
+  }
+
+  uint16_t size = varintLength + 3 + kept;
+
+  while (I2C_CAPTURE_SIZE - used < size)
+  {
+    dropOldest();
+  }
+
+  while (delta >= 0x80)
+  {
+    put((delta & 0x7F) | 0x80);
+    delta >>= 7;
+  }
+  put(delta);
+
+  put((address << 1) | (read ? 1 : 0));
+  put(result);
+  put(len > 0xFF ? 0xFF : len);
+
+  for (uint8_t i = 0; i < kept; i++)
+  {
+    put(data[i]);
+  }
+
+  records++;
+}
+
+void I2CCapture::put(uint8_t value)
+{
+  ring[head] = value;
+  head = (head + 1) % I2C_CAPTURE_SIZE;
+  used++;
+}
+
+// byte at an offset from the oldest record
+uint8_t I2CCapture::at(uint16_t offset)
+{
+  return ring[(tail + offset) % I2C_CAPTURE_SIZE];
+}
+
+void I2CCapture::dropOldest()
+{
+  uint16_t size = 0;
+
+  while (at(size) & 0x80)
+  {
+    size++;
+  }
+  size++;
+
+  uint8_t len = at(size + 2);
+  size += 3 + (len < I2C_CAPTURE_MAX_DATA ? len : I2C_CAPTURE_MAX_DATA);
+
+  tail = (tail + size) % I2C_CAPTURE_SIZE;
+  used -= size;
+  records--;
+  dropped++;
+}
+
+// hex lines between a header and an end marker, tools/i2c_replay reads them back
+void I2CCapture::dump()
+{
+  static const char hex[] = "0123456789abcdef";
+
+  Log(MQTT_I2C_CAPTURE_TOPIC, ("I2C capture " + String(used) + " bytes " + String(records) + " records " + String(dropped) + " dropped").c_str());
+
+  char line[I2C_CAPTURE_DUMP_CHUNK * 2 + 1];
+
+  for (uint16_t offset = 0; offset < used; offset += I2C_CAPTURE_DUMP_CHUNK)
+  {
+    uint16_t n = 0;
+
+    for (; n < I2C_CAPTURE_DUMP_CHUNK && offset + n < used; n++)
+    {
+      uint8_t value = at(offset + n);
+      line[n * 2] = hex[value >> 4];
+      line[n * 2 + 1] = hex[value & 0x0F];
+    }
+    line[n * 2] = 0;
+
+    Log(MQTT_I2C_CAPTURE_TOPIC, line);
+
+    yield();
+  }
+
+  Log(MQTT_I2C_CAPTURE_TOPIC, "I2C capture end");
+}
+
+void I2CCapture::clear()
+{
+  head = tail = used = 0;
+  records = dropped = 0;
+}
+
+#endif
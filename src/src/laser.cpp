@@ -1,48 +1,235 @@
 #include <Arduino.h>
 #include "laser.h"
 
-Laser::Laser() : lox()
+#ifdef LASER_INTERRUPT_PIN
+static volatile bool laserReady = false;
+static volatile unsigned long laserReadyAt = 0;
+
+static void ICACHE_RAM_ATTR laserInterrupt()
+{
+  laserReady = true;
+  laserReadyAt = micros();
+}
+#endif
+
+Laser::Laser() : lox(), outliers(LASER_HAMPEL_THRESHOLD, LASER_HAMPEL_MIN_MAD, true)
 {
   Log("Load Laser");
+
+  sample.rangeMilliMeter = INT_MAX;
+  sample.timestamp = 0;
+  sample.sequence = 0;
+  filteredAt = 0;
+
+  profile = LASER_PROFILE_DEFAULT;
+  profileSince = 0;
+  profileSwitches = 0;
+  interruptTimeouts = 0;
+  samplesSinceStats = 0;
+  statsSince = 0;
 }
 
-void Laser::Begin()
+// false when the sensor doesn't start, the car runs without it
+bool Laser::Begin()
 {
   Log("Adafruit VL53L0X initialise");
 
   if (!lox.begin())
   {
     Log("Failed to boot VL53L0X");
-    delay(1000);
-    ESP.restart();
+    return false;
   }
 
+#ifdef LASER_INTERRUPT_PIN
+  // GPIO1 goes low when a new sample is ready
+  lox.setGpioConfig(VL53L0X_DEVICEMODE_CONTINUOUS_TIMED_RANGING, VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY, VL53L0X_INTERRUPTPOLARITY_LOW);
+  pinMode(LASER_INTERRUPT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(LASER_INTERRUPT_PIN), laserInterrupt, FALLING);
+#endif
+
+  // keep ranging in the background, Loop only collects the results
+  lox.startRangeContinuous(LASER_PERIOD_MS);
+
+  // isLost counts from here, and a restarted laser starts a new window
+  sample.timestamp = micros();
+  outliers.reset();
+
+#ifdef LASER_INTERRUPT_PIN
+  laserReadyAt = micros();
+#endif
+
   // power
   Log("VL53L0X ready");
+
+  return true;
 }
 
+// returns straight away with the latest range, only touching more than
+// the interrupt status register (nothing at all in interrupt mode) when
+// the sensor has a new sample
 int Laser::Loop()
 {
-  int laserRangeMilliMeter = INT_MAX;
+  publishStats();
+
+#ifdef LASER_INTERRUPT_PIN
+  // no new sample, don't touch the bus. unless no interrupt has come for a
+  // few budgets: GPIO1 already low when the interrupt was attached or the
+  // ranging restarted, or left low by an interrupt clear that failed, never
+  // falls again. collecting the sample clears it and the edges start again
+  bool edge = laserReady;
+
+  if (edge == false && micros() - laserReadyAt < LASER_INTERRUPT_TIMEOUT_BUDGETS * budgetMicros())
+  {
+    return sample.rangeMilliMeter;
+  }
+
+  laserReady = false;
+
+  if (edge == false)
+  {
+    laserReadyAt = micros(); // poll once per timeout, not every loop
+    interruptTimeouts++;
+
+    if (lox.isRangeComplete() == false)
+    {
+      return sample.rangeMilliMeter;
+    }
+  }
 
-  VL53L0X_RangingMeasurementData_t measure;
+  sample.timestamp = laserReadyAt;
+#else
+  if (lox.isRangeComplete() == false)
+  {
+    return sample.rangeMilliMeter;
+  }
 
-  lox.rangingTest(&measure, false); // pass in 'true' to get debug data printout!
+  sample.timestamp = micros();
+#endif
 
-  if (measure.RangeStatus != 4)
+  uint16_t rangeMilliMeter = lox.readRange();
+
+  sample.sequence++;
+  samplesSinceStats++;
+
+  if (lox.readRangeStatus() != 4 && rangeMilliMeter != 0xFFFF)
   { // phase failures have incorrect data
-    laserRangeMilliMeter = measure.RangeMilliMeter;
+    // a window from before a gap in the samples would hold back the range
+    if (sample.timestamp - filteredAt > LASER_HAMPEL_MAX_GAP_BUDGETS * budgetMicros())
+    {
+      outliers.reset();
+    }
+
+    filteredAt = sample.timestamp;
+    sample.rangeMilliMeter = outliers.in(rangeMilliMeter);
 
     // publish laser distance to topic
-    Log(MQTT_LASER_TOPIC, String(laserRangeMilliMeter).c_str());
+    Log(MQTT_LASER_TOPIC, String(sample.rangeMilliMeter).c_str());
   }
   else
   {
-    laserRangeMilliMeter = INT_MAX;
+    sample.rangeMilliMeter = INT_MAX;
+    outliers.reset();
 
     // publish laser distance to topic
     Log(MQTT_LASER_TOPIC, "out of range");
   }
 
-  return laserRangeMilliMeter;
+  return sample.rangeMilliMeter;
+}
+
+LaserSample Laser::getSample()
+{
+  return sample;
+}
+
+// no new sample for LASER_LOST_BUDGETS budgets, a connector come loose
+// or the sensor reset, Loop would serve the last range for ever
+bool Laser::isLost()
+{
+  return micros() - sample.timestamp > LASER_LOST_BUDGETS * budgetMicros();
+}
+
+// fast updates when near something or braking, precise ones when
+// crawling or parked in the open, the default otherwise. braking zeroes
+// the duty right next to an obstacle, which mustn't slow the laser down
+void Laser::adapt(int commandedDuty, int rangeMilliMeter, bool braking)
+{
+  uint8_t wanted = LASER_PROFILE_DEFAULT;
+
+  if (braking == true || rangeMilliMeter < LASER_NEAR_MM)
+  {
+    wanted = LASER_PROFILE_HIGH_SPEED;
+  }
+  else if (commandedDuty <= LASER_CRAWL_DUTY)
+  {
+    wanted = LASER_PROFILE_ACCURATE;
+  }
+
+  if (wanted == profile)
+  {
+    return;
+  }
+
+  // never hold back the switch to high speed, don't flap otherwise
+  if (wanted != LASER_PROFILE_HIGH_SPEED && millis() - profileSince < LASER_PROFILE_DWELL_MS)
+  {
+    return;
+  }
+
+  setProfile(wanted);
+}
+
+void Laser::setProfile(uint8_t newProfile)
+{
+  static const VL53L0X_Sense_config_t configs[] = {VL53L0X_SENSE_HIGH_SPEED, VL53L0X_SENSE_DEFAULT, VL53L0X_SENSE_HIGH_ACCURACY};
+  static const char *names[] = {"high speed", "default", "accurate"};
+
+  // the timing budget can only change while the sensor is idle
+  lox.stopRangeContinuous();
+  lox.configSensor(configs[newProfile]);
+  lox.startRangeContinuous(LASER_PERIOD_MS);
+
+#ifdef LASER_INTERRUPT_PIN
+  laserReadyAt = micros();
+#endif
+
+  // the samples in the window were ranged with the old budget
+  outliers.reset();
+
+  profile = newProfile;
+  profileSince = millis();
+  profileSwitches++;
+
+  Log(MQTT_LASER_STATS_TOPIC, (String("profile ") + names[newProfile]).c_str());
+}
+
+// time between samples in the current profile, the timing budget plus
+// the inter-measurement period
+unsigned long Laser::budgetMicros()
+{
+  static const unsigned long budgets[] = {20000, 33000, 200000};
+
+  return budgets[profile] + LASER_PERIOD_MS * 1000UL;
+}
+
+// sample rate, profile switches and rejected outliers once a second
+void Laser::publishStats()
+{
+  unsigned long elapsed = millis() - statsSince;
+
+  if (elapsed < 1000)
+  {
+    return;
+  }
+
+  String msg = "profile " + String(profile) + " switches " + String(profileSwitches) + " rate " + String(samplesSinceStats * 1000 / elapsed) + "/s rejected " + String(outliers.getRejected()) + "/" + String(outliers.getSamples());
+
+#ifdef LASER_INTERRUPT_PIN
+  msg += " interrupt timeouts " + String(interruptTimeouts);
+#endif
+
+  Log(MQTT_LASER_STATS_TOPIC, msg.c_str());
+
+  samplesSinceStats = 0;
+  statsSince = millis();
 }
@@ -0,0 +1,37 @@
+#include "leastSquares.h"
+
+long leastSquaresSlope(const long *values, const unsigned long *timestamps, uint8_t window, uint8_t next, uint8_t count)
+{
+  if (count < 2)
+  {
+    return 0;
+  }
+
+  uint8_t oldest = (next + window - count) % window;
+
+  int64_t sumT = 0, sumV = 0, sumTT = 0, sumTV = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    uint8_t s = (oldest + i) % window;
+
+    // relative to the oldest sample, wraps correctly with micros()
+    int64_t t = (unsigned long)(timestamps[s] - timestamps[oldest]);
+    int64_t v = values[s] - values[oldest];
+
+    sumT += t;
+    sumV += v;
+    sumTT += t * t;
+    sumTV += t * v;
+  }
+
+  int64_t denominator = count * sumTT - sumT * sumT;
+
+  if (denominator == 0)
+  {
+    return 0;
+  }
+
+  // slope per us, scaled to per second
+  return (long)((count * sumTV - sumT * sumV) * 1000000 / denominator);
+}
@@ -12,10 +12,16 @@
 #include "motors.h"
 #include "batteries.h"
 #include "nunchuck.h"
-
-void i2c_scanner();
+#include "i2cBus.h"
+#include "i2cCapture.h"
+#include "medianBenchmark.h"
+#include "atan2Benchmark.h"
 
 PubSubClient MQTTClient;
+I2CBus i2cBus;
+#ifdef I2C_CAPTURE
+I2CCapture i2cCapture;
+#endif
 MQTT mqtt;
 Battery battery;
 Motors motors;
@@ -23,39 +29,205 @@ Nunchuck nunchuck;
 Laser laser;
 Compass compass;
 
+uint8_t capabilities = 0;
+unsigned long sensorsRetriedAt = 0;
+unsigned long loopStartedAt = 0;
+
+//bring up one part of the car if it answered on the bus, false if it isn't there
+bool startPart(uint8_t capability)
+{
+  switch (capability)
+  {
+  case CAPABILITY_LASER:
+    return i2cBus.present(I2C_ADDRESS_LASER) == true && laser.Begin() == true;
+
+  case CAPABILITY_COMPASS:
+    //the calibration reads would wait forever on a missing compass
+    if (i2cBus.present(I2C_ADDRESS_COMPASS) == false)
+    {
+      return false;
+    }
+    compass.Begin();
+    return true;
+
+  case CAPABILITY_NUNCHUCK:
+    if (i2cBus.present(I2C_ADDRESS_NUNCHUCK) == false)
+    {
+      return false;
+    }
+    nunchuck.nunchuck_init();
+    return true;
+
+  case CAPABILITY_MOTORS:
+    return i2cBus.present(I2C_ADDRESS_LEFT_MOTORS) == true && i2cBus.present(I2C_ADDRESS_RIGHT_MOTORS) == true && motors.Begin() == true;
+  }
+
+  return false;
+}
+
+//speed is capped while there is no laser to slow down for obstacles
+void applyCapabilities()
+{
+  motors.setDutyCap((capabilities & CAPABILITY_LASER) ? 100 : NO_LASER_MAX_DUTY);
+
+  Log(MQTT_I2C_TOPIC, ("capabilities 0x" + String(capabilities, HEX)).c_str());
+}
+
+//look for missing parts again now and then instead of rebooting. only
+//while stopped, starting a part blocks the loop for up to a few seconds
+//(the compass calibration reads, the motor shields' 50ms replies)
+void retryMissingParts()
+{
+  if (millis() - sensorsRetriedAt < SENSOR_RETRY_MS)
+  {
+    return;
+  }
+
+  if (motors.getCommandedDuty() != 0 || motors.isBraking() == true)
+  {
+    return;
+  }
+
+  sensorsRetriedAt = millis();
+
+  static const uint8_t parts[] = {CAPABILITY_LASER, CAPABILITY_COMPASS, CAPABILITY_NUNCHUCK, CAPABILITY_MOTORS};
+  static const uint8_t addresses[] = {I2C_ADDRESS_LASER, I2C_ADDRESS_COMPASS, I2C_ADDRESS_NUNCHUCK, I2C_ADDRESS_LEFT_MOTORS};
+  bool changed = false;
+
+  for (uint8_t i = 0; i < sizeof(parts); i++)
+  {
+    if ((capabilities & parts[i]) != 0)
+    {
+      continue;
+    }
+
+    if (parts[i] == CAPABILITY_MOTORS)
+    {
+      i2cBus.probe(I2C_ADDRESS_RIGHT_MOTORS);
+    }
+
+    if (i2cBus.probe(addresses[i]) == true && startPart(parts[i]) == true)
+    {
+      capabilities |= parts[i];
+      changed = true;
+    }
+  }
+
+  if (changed == true)
+  {
+    applyCapabilities();
+  }
+}
+
+//drop a part that has stopped producing, so the duty cap and the heading
+//features follow, retryMissingParts brings it back once it answers again
+void dropLostParts()
+{
+  uint8_t lost = 0;
+
+  if ((capabilities & CAPABILITY_LASER) && laser.isLost() == true)
+  {
+    lost |= CAPABILITY_LASER;
+  }
+
+  if ((capabilities & CAPABILITY_COMPASS) && compass.isLost() == true)
+  {
+    lost |= CAPABILITY_COMPASS;
+  }
+
+  if ((capabilities & CAPABILITY_NUNCHUCK) && nunchuck.isLost() == true)
+  {
+    lost |= CAPABILITY_NUNCHUCK;
+  }
+
+  if (lost == 0)
+  {
+    return;
+  }
+
+  capabilities &= ~lost;
+
+  Log(MQTT_I2C_TOPIC, ("lost 0x" + String(lost, HEX)).c_str());
+  applyCapabilities();
+}
+
 void setup()
 {
   Serial.begin(115200);
   Serial.println("Starting");
 
-  Wire.begin();
-
   setupWifi();
   setupOTA();
 
   //start MQTT
   mqtt.Begin();
 
-  i2c_scanner();
+  //join the I2C bus at the configured speed
+  i2cBus.Begin();
+
+  //see what is on the bus, boot with whatever answered
+  if (i2cBus.discover() == 0)
+  {
+    Log("No I2C devices found");
+  }
 
   //start laser beam
-  laser.Begin();
+  if (startPart(CAPABILITY_LASER) == true)
+  {
+    capabilities |= CAPABILITY_LASER;
+  }
 
   //start compass
-  compass.Begin();
+  if (startPart(CAPABILITY_COMPASS) == true)
+  {
+    capabilities |= CAPABILITY_COMPASS;
+  }
 
   //get battery reading
   battery.Begin();
 
   //get nunchuck ready
-  nunchuck.nunchuck_init();
+  if (startPart(CAPABILITY_NUNCHUCK) == true)
+  {
+    capabilities |= CAPABILITY_NUNCHUCK;
+  }
 
   //get motors ready
-  motors.Begin();
+  if (startPart(CAPABILITY_MOTORS) == true)
+  {
+    capabilities |= CAPABILITY_MOTORS;
+  }
+
+  applyCapabilities();
+  sensorsRetriedAt = millis();
+  loopStartedAt = millis();
+
+#ifdef I2C_BENCHMARK
+  i2cBus.Benchmark();
+#endif
+
+#ifdef MEDIAN_BENCHMARK
+  medianBenchmark();
+#endif
+
+#ifdef ATAN2_BENCHMARK
+  atan2Benchmark();
+#endif
+
+  //set the drivers up again if the bus ever locks up
+  i2cBus.onRecovery([]() { if (capabilities & CAPABILITY_COMPASS) compass.reinit(); });
+  i2cBus.onRecovery([]() { if (capabilities & CAPABILITY_NUNCHUCK) nunchuck.nunchuck_init(); });
+  i2cBus.onRecovery([]() { if (capabilities & CAPABILITY_MOTORS) motors.reinit(); });
 }
 
 void loop()
 {
+  //check nothing is holding the I2C bus
+  i2cBus.Loop();
+
+  //bring back anything that was missing
+  retryMissingParts();
+
   //make code smarter if it's not on the network it should still work
   if (WiFi.isConnected() == true)
   {
@@ -66,74 +238,106 @@ void loop()
   MotorXY motorXY;
   motorXY = mqtt.Loop();
 
-  if (motorXY.fromMQTT == false)
+  String command = mqtt.takeCommand();
+
+  if (command == "i2c_benchmark")
+  {
+    i2cBus.Benchmark();
+  }
+  else if (command == "i2c_scan")
+  {
+    i2cBus.scan();
+  }
+  else if (command == "compass_recalibrate" && (capabilities & CAPABILITY_COMPASS))
+  {
+    compass.recalibrate();
+  }
+  else if (command == "compass_save" && (capabilities & CAPABILITY_COMPASS))
+  {
+    compass.save();
+  }
+#ifdef MEDIAN_BENCHMARK
+  else if (command == "median_benchmark")
+  {
+    medianBenchmark();
+  }
+#endif
+#ifdef ATAN2_BENCHMARK
+  else if (command == "atan2_benchmark")
+  {
+    atan2Benchmark();
+  }
+#endif
+#ifdef I2C_CAPTURE
+  else if (command == "i2c_capture_dump")
+  {
+    i2cCapture.dump();
+  }
+  else if (command == "i2c_capture_clear")
+  {
+    i2cCapture.clear();
+  }
+#endif
+
+  if (motorXY.fromMQTT == false && (capabilities & CAPABILITY_NUNCHUCK))
   {
     motorXY = nunchuck.Loop();
   }
 
   //go and get laser and compass values
-  int laserRangeMilliMeter = laser.Loop();
-  int medianCompassHeading = compass.Loop();
-  int motor_x = motorXY.motor_x;
-  int motor_y = motorXY.motor_y;
-
-  motors.setMapped(motor_x, motor_y, laserRangeMilliMeter); //, medianCompassHeading);
-
-  delay(50);
-}
+  int laserRangeMilliMeter = INT_MAX;
 
-void i2c_scanner()
-{
-  yield();
+  if (capabilities & CAPABILITY_LASER)
+  {
+    laserRangeMilliMeter = laser.Loop();
 
-  byte error, address;
-  int nDevices;
+    //brake before anything else if we are about to hit something
+    motors.checkCollision(laser.getSample());
+  }
 
-  Log("Scanning...");
+  int medianCompassHeading = 0;
 
-  nDevices = 0;
-  for (address = 1; address < 127; address++)
+  if (capabilities & CAPABILITY_COMPASS)
   {
-    yield();
+    medianCompassHeading = compass.Loop();
 
-    delay(5);
+    //stop if turning on the spot isn't turning us
+    motors.checkStall(compass.getYawRate(), compass.yawRateReady());
+  }
 
-    // The i2c scanner uses the return value of the Write.endTransmisstion to see if a device did acknowledge to the address.
-    Wire.beginTransmission(address);
-    error = Wire.endTransmission();
+  //stop trusting anything that has gone quiet, including what it said last
+  dropLostParts();
 
-    if (error == 0)
-    {
-      Log("I2C device found at address 0x");
-      if (address < 16)
-      {
-        Log("0");
-      }
-      Log(String(address));
-      Log(" !");
-
-      nDevices++;
-    }
-    else if (error == 4)
-    {
-      Log("Unknown error at address 0x");
-      if (address < 16)
-      {
-        Log("0");
-      }
-      Log(String(address));
-    }
+  if ((capabilities & CAPABILITY_LASER) == 0)
+  {
+    laserRangeMilliMeter = INT_MAX;
   }
-  if (nDevices == 0)
+
+  if ((capabilities & CAPABILITY_COMPASS) == 0)
   {
-    Log("No I2C devices found\n");
+    medianCompassHeading = 0;
+  }
 
-    delay(500);
+  int motor_x = motorXY.motor_x;
+  int motor_y = motorXY.motor_y;
 
-    ESP.restart();
+  if (capabilities & CAPABILITY_MOTORS)
+  {
+    motors.setMapped(motor_x, motor_y, laserRangeMilliMeter, medianCompassHeading);
+
+    //heading hold step when one is due, with the heading just read
+    motors.holdHeading(medianCompassHeading, compass.getTimestamp());
   }
-  else
+
+  //fast laser updates when near something or braking, accurate ones when crawling
+  if (capabilities & CAPABILITY_LASER)
   {
-    Log("Done.\n");
+    laser.adapt(motors.getCommandedDuty(), laserRangeMilliMeter, motors.isBraking());
   }
+
+  //wait out the rest of the period, so time spent on the network and
+  //logging doesn't stretch it
+  unsigned long spent = millis() - loopStartedAt;
+  delay(spent < LOOP_PERIOD_MS ? LOOP_PERIOD_MS - spent : 0);
+  loopStartedAt += spent < LOOP_PERIOD_MS ? LOOP_PERIOD_MS : spent;
 }
@@ -0,0 +1,84 @@
+#ifdef MEDIAN_BENCHMARK
+
+#include "medianBenchmark.h"
+#include <MedianFilterBank.h>
+
+// the same pseudo random samples on every run, -1000 .. 1000
+static int nextSample(uint32_t &state)
+{
+  state = state * 1103515245UL + 12345UL;
+  return (int)((state >> 16) % 2001) - 1000;
+}
+
+template <size_t N>
+static void benchmarkWindow()
+{
+  const size_t K = MEDIAN_BENCHMARK_CHANNELS;
+  static MedianFilterBank<int, K, N> bank(0);
+  static MedianFilter<int, N> filters[K];
+  int batch[K];
+  long checksum = 0;
+
+  bank.reset(0);
+  for (size_t c = 0; c < K; c++)
+  {
+    filters[c].reset(0);
+  }
+
+  uint32_t state = 1;
+  unsigned long started = micros();
+
+  for (int i = 0; i < MEDIAN_BENCHMARK_BATCHES; i++)
+  {
+    for (size_t c = 0; c < K; c++)
+    {
+      batch[c] = nextSample(state);
+    }
+
+    const int *medians = bank.in(batch);
+    for (size_t c = 0; c < K; c++)
+    {
+      checksum += medians[c];
+    }
+  }
+
+  unsigned long bankMicros = micros() - started;
+
+  yield();
+
+  state = 1;
+  started = micros();
+
+  for (int i = 0; i < MEDIAN_BENCHMARK_BATCHES; i++)
+  {
+    for (size_t c = 0; c < K; c++)
+    {
+      batch[c] = nextSample(state);
+    }
+
+    for (size_t c = 0; c < K; c++)
+    {
+      checksum -= filters[c].in(batch[c]);
+    }
+  }
+
+  unsigned long filtersMicros = micros() - started;
+
+  yield();
+
+  // checksum is 0 when both gave the same medians
+  String msg = "window " + String(N) + " bank " + String(bankMicros * 1000UL / MEDIAN_BENCHMARK_BATCHES) + "ns filters " + String(filtersMicros * 1000UL / MEDIAN_BENCHMARK_BATCHES) + "ns per batch of " + String(K) + (checksum == 0 ? "" : " MISMATCH");
+
+  Log(MQTT_MEDIAN_BENCHMARK_TOPIC, msg.c_str());
+}
+
+void medianBenchmark()
+{
+  Log(MQTT_MEDIAN_BENCHMARK_TOPIC, "median benchmark start");
+
+  benchmarkWindow<7>();
+  benchmarkWindow<15>();
+  benchmarkWindow<31>();
+}
+
+#endif
@@ -1,31 +1,181 @@
 #include "motors.h"
 
-Motors::Motors() : leftMotors(0x09), rightMotors(DEFAULT_I2C_MOTOR_ADDRESS)
+Motors::Motors() : leftMotors(I2C_ADDRESS_LEFT_MOTORS), rightMotors(I2C_ADDRESS_RIGHT_MOTORS), commandedDuty(0), dutyCap(100), forward(false), braking(false), lastLaserSequence(0), straightDuty(0), trimSent(0), holdStatsSince(0), rotating(0), stalled(false), rotatingSince(0), refreshedAt(0)
 {
   Log("Motor Shield load");
+
+  leftSent = {-1, -1, 0};
+  rightSent = {-1, -1, 0};
 }
 
-void Motors::Begin()
+// false when a shield never answers
+bool Motors::Begin()
 {
   Log("Motor Shield init");
 
-  while (leftMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR) //wait motor shield ready.
+  for (int i = 0; i < MOTORS_BEGIN_TRIES && leftMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR; i++) //wait motor shield ready.
   {
     leftMotors.getInfo();
   }
 
-  while (rightMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR) //wait motor shield ready.
+  for (int i = 0; i < MOTORS_BEGIN_TRIES && rightMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR; i++) //wait motor shield ready.
   {
     rightMotors.getInfo();
   }
 
+  if (leftMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR || rightMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR)
+  {
+    Log("Motor Shield not answering");
+    return false;
+  }
+
   Log("Change A to CCW, B to CW, Freq: 1000Hz");
 
   leftMotors.changeFreq(MOTOR_CH_BOTH, 1000);  //Change A & B 's Frequency to 1000Hz.
   rightMotors.changeFreq(MOTOR_CH_BOTH, 1000); //Change A & B 's Frequency to 1000Hz.
+
+  forgetSent();
+
+  return true;
+}
+
+// highest duty setMapped will use, lowered when a sensor is missing
+void Motors::setDutyCap(int cap)
+{
+  dutyCap = cap;
+}
+
+// highest duty sent by the last setMapped, 0 when stopped
+int Motors::getCommandedDuty()
+{
+  return commandedDuty;
+}
+
+// short braked on a time to collision and not released by setMapped yet
+bool Motors::isBraking()
+{
+  return braking;
+}
+
+// the high priority path, called as soon as the laser has a new sample.
+// short brakes straight away when driving forward towards something we
+// would reach within TTC_BRAKE_MS
+void Motors::checkCollision(const LaserSample &sample)
+{
+  if (sample.sequence == lastLaserSequence)
+  {
+    return;
+  }
+
+  lastLaserSequence = sample.sequence;
+  rangeRate.add(sample.rangeMilliMeter, sample.timestamp);
+
+  if (forward == true && braking == false && rangeRate.ttcMillis() < TTC_BRAKE_MS)
+  {
+    brake();
+  }
+}
+
+// stops the motors when turning on the spot isn't turning the car,
+// a wheel caught or the car wedged, rather than stalling them at full duty
+void Motors::checkStall(long yawRate, bool yawRateReady)
+{
+  if (rotating == 0 || stalled == true || yawRateReady == false)
+  {
+    return;
+  }
+
+  if (millis() - rotatingSince < STALL_AFTER_MS || abs(yawRate) >= STALL_MIN_YAW_RATE)
+  {
+    return;
+  }
+
+  sendStatus(leftMotors, leftSent, MOTOR_STATUS_STOP);
+  sendStatus(rightMotors, rightSent, MOTOR_STATUS_STOP);
+
+  stalled = true;
+  commandedDuty = 0;
+
+  Log(MQTT_DIRECTION_TOPIC, "STALL yaw " + String(yawRate) + "deg/s");
+}
+
+void Motors::brake()
+{
+  sendStatus(leftMotors, leftSent, MOTOR_STATUS_SHORT_BRAKE);
+  sendStatus(rightMotors, rightSent, MOTOR_STATUS_SHORT_BRAKE);
+
+  braking = true;
+  commandedDuty = 0;
+
+  Log(MQTT_DIRECTION_TOPIC, "BRAKE ttc " + String(rangeRate.ttcMillis()) + "ms at " + String(rangeRate.closingSpeed()) + "mm/s");
+}
+
+// check the shields still answer after an I2C bus recovery
+void Motors::reinit()
+{
+  leftMotors.getInfo();
+  rightMotors.getInfo();
+
+  if (leftMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR || rightMotors.PRODUCT_ID != PRODUCT_ID_I2C_MOTOR)
+  {
+    Log("Motor Shield not answering after I2C recovery");
+  }
+
+  //a shield that reset has forgotten what it was told
+  forgetSent();
+}
+
+//only a change goes to a shield, a write to a shield that was just written
+//to waits out the rest of MOTORS_MIN_WRITE_GAP_US first. a pair of writes
+//to both shields needs no wait, the other shield's write spaces them
+void Motors::sendDuty(LOLIN_I2C_MOTOR &shield, ShieldSent &sent, int duty)
+{
+  if (duty == sent.duty)
+  {
+    return;
+  }
+
+  unsigned long since = micros() - sent.writtenAt;
+  if (since < MOTORS_MIN_WRITE_GAP_US)
+  {
+    delayMicroseconds(MOTORS_MIN_WRITE_GAP_US - since);
+  }
+
+  shield.changeDuty(MOTOR_CH_BOTH, duty, false);
+  sent.duty = duty;
+  sent.writtenAt = micros();
+}
+
+void Motors::sendStatus(LOLIN_I2C_MOTOR &shield, ShieldSent &sent, int status)
+{
+  if (status == sent.status)
+  {
+    return;
+  }
+
+  unsigned long since = micros() - sent.writtenAt;
+  if (since < MOTORS_MIN_WRITE_GAP_US)
+  {
+    delayMicroseconds(MOTORS_MIN_WRITE_GAP_US - since);
+  }
+
+  shield.changeStatus(MOTOR_CH_BOTH, status, false);
+  sent.status = status;
+  sent.writtenAt = micros();
 }
 
-void Motors::setMapped(int mapx, int mapy, int laserRangeMilliMeter) //, int medianCompassHeading)
+//the next commands go out whether they changed or not
+void Motors::forgetSent()
+{
+  leftSent.duty = -1;
+  leftSent.status = -1;
+  rightSent.duty = -1;
+  rightSent.status = -1;
+  refreshedAt = millis();
+}
+
+// medianCompassHeading is 1 to 360, 0 when there is no heading to hold
+void Motors::setMapped(int mapx, int mapy, int laserRangeMilliMeter, int medianCompassHeading)
 {
   int maxDuty = 50;         //100;
   int maxRotationDuty = 50; //50;
@@ -35,6 +185,15 @@ void Motors::setMapped(int mapx, int mapy, int laserRangeMilliMeter) //, int med
   int minimumDuty = 16;
   String Direction = "";
 
+  //nothing is sent while the command stays the same, now and then it is anyway
+  if (millis() - refreshedAt >= MOTORS_REFRESH_MS)
+  {
+    forgetSent();
+  }
+
+  maxDuty = min(maxDuty, dutyCap);
+  maxRotationDuty = min(maxRotationDuty, dutyCap);
+
   if (laserRangeMilliMeter > SafeDistanceMM)
   {
     Duty = maxDuty;
@@ -50,110 +209,137 @@ void Motors::setMapped(int mapx, int mapy, int laserRangeMilliMeter) //, int med
 
   int maxTurnDuty = maxDuty / 2;
 
+  forward = mapy == 1;
+  straightDuty = 0;
+
+  //stay braked until we are no longer closing in on something
+  if (forward == true && braking == true && rangeRate.ttcMillis() < TTC_BRAKE_MS)
+  {
+    Log(MQTT_DIRECTION_TOPIC, "BRAKE");
+    return;
+  }
+
+  braking = false;
+
+  //hold the heading we had when driving straight ahead or back started
+  uint8_t holdDirection = HEADING_HOLD_OFF;
+  if (mapx == 0 && mapy == 1)
+  {
+    holdDirection = HEADING_HOLD_NORTH;
+  }
+  else if (mapx == 0 && mapy == -1)
+  {
+    holdDirection = HEADING_HOLD_SOUTH;
+  }
+
+  headingHold.hold(holdDirection, medianCompassHeading, millis());
+
+  //turning on the spot, watched by checkStall
+  int nowRotating = mapy == 0 ? mapx : 0;
+  if (nowRotating != rotating)
+  {
+    rotatingSince = millis();
+    stalled = false;
+  }
+  rotating = nowRotating;
+
+  if (stalled == true)
+  {
+    //stay stopped until the command changes
+    return;
+  }
+
+  publishHoldStats();
+
   Log("mapx: " + String(mapx) + " mapy: " + String(mapy) + " Duty: " + String(Duty));
 
   if (mapx == 0 && mapy == 1)
   {
     //North
 
-    //take only the first reading as the starting heading
-    // if (compassHeadingWhenStartedLinear == -1)
-    // {
-    //   compassHeadingWhenStartedLinear = medianCompassHeading;
-    // }
-
-    int DutyLeft = Duty;
-    int DutyRight = Duty;
-
-    // if (autoCorrectWithCompass == true)
-    // {
-    //   if (medianCompassHeading > compassHeadingWhenStartedLinear)
-    //   {
-    //     DutyRight = DutyRight * 0.9;
-    //   }
-
-    //   if (medianCompassHeading < compassHeadingWhenStartedLinear)
-    //   {
-    //     DutyLeft = DutyLeft * 0.9;
-    //   }
-    // }
-
-    leftMotors.changeDuty(MOTOR_CH_BOTH, DutyLeft);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, DutyRight);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
+    //nothing to trim when the laser has us stopped
+    straightDuty = Duty;
+    driveStraight();
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CW);
     Direction = "NORTH";
   }
   else if (mapx == 1 and mapy == 1)
   {
     //North East
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxTurnDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
+    sendDuty(leftMotors, leftSent, maxDuty);
+    sendDuty(rightMotors, rightSent, maxTurnDuty);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CW);
     Direction = "NORTH EAST";
+    commandedDuty = maxDuty;
   }
   else if (mapx == 1 and mapy == 0)
   {
     //East
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxRotationDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxRotationDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
+    sendDuty(leftMotors, leftSent, maxRotationDuty);
+    sendDuty(rightMotors, rightSent, maxRotationDuty);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CCW);
     Direction = "EAST";
+    commandedDuty = maxRotationDuty;
   }
   else if (mapx == 1 and mapy == -1)
   {
     //South East
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxTurnDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
+    sendDuty(leftMotors, leftSent, maxDuty);
+    sendDuty(rightMotors, rightSent, maxTurnDuty);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CCW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CCW);
     Direction = "SOUTH EAST";
+    commandedDuty = maxDuty;
   }
   else if (mapx == 0 and mapy == -1)
   {
     //South
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
+    straightDuty = maxDuty;
+    driveStraight();
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CCW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CCW);
     Direction = "SOUTH";
   }
   else if (mapx == -1 and mapy == -1)
   {
     //South West
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxTurnDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
+    sendDuty(leftMotors, leftSent, maxTurnDuty);
+    sendDuty(rightMotors, rightSent, maxDuty);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CCW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CCW);
     Direction = "SOUTH WEST";
+    commandedDuty = maxDuty;
   }
   else if (mapx == -1 and mapy == 0)
   {
     //West
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxRotationDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxRotationDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CCW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
+    sendDuty(leftMotors, leftSent, maxRotationDuty);
+    sendDuty(rightMotors, rightSent, maxRotationDuty);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CCW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CW);
     Direction = "WEST";
+    commandedDuty = maxRotationDuty;
   }
   else if (mapx == -1 and mapy == 1)
   {
     //North West
-    leftMotors.changeDuty(MOTOR_CH_BOTH, maxTurnDuty);
-    rightMotors.changeDuty(MOTOR_CH_BOTH, maxDuty);
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
+    sendDuty(leftMotors, leftSent, maxTurnDuty);
+    sendDuty(rightMotors, rightSent, maxDuty);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_CW);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_CW);
     Direction = "NORTH WEST";
+    commandedDuty = maxDuty;
   }
   else
   {
     //Stop..
-    leftMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_STOP);
-    rightMotors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_STOP);
+    sendStatus(leftMotors, leftSent, MOTOR_STATUS_STOP);
+    sendStatus(rightMotors, rightSent, MOTOR_STATUS_STOP);
     Direction = "STOP";
-    //compassHeadingWhenStartedLinear = -1;
+    commandedDuty = 0;
   }
   // publish direction to topic
   if (Direction != "STOP")
@@ -161,3 +347,60 @@ void Motors::setMapped(int mapx, int mapy, int laserRangeMilliMeter) //, int med
     Log(MQTT_DIRECTION_TOPIC, Direction);
   }
 }
+
+// the heading hold's own slot, called every loop with the latest compass
+// heading. the controller steps on its fixed period whatever setMapped is
+// doing, and a new trim goes to the shields straight away
+void Motors::holdHeading(int medianCompassHeading, unsigned long headingTimestamp)
+{
+  if (headingHold.step(medianCompassHeading, headingTimestamp, millis()) == false)
+  {
+    return;
+  }
+
+  if (straightDuty == 0 || braking == true || stalled == true || headingHold.getTrim() == trimSent)
+  {
+    return;
+  }
+
+  driveStraight();
+}
+
+// straightDuty with the heading hold's trim, left gets it and right the
+// opposite. doesn't wait for the shields, the 50ms reply would hold up
+// the control loop
+void Motors::driveStraight()
+{
+  trimSent = straightDuty > 0 ? headingHold.getTrim() : 0;
+
+  int dutyLeft = constrain(straightDuty + trimSent, 0, 100);
+  int dutyRight = constrain(straightDuty - trimSent, 0, 100);
+
+  sendDuty(leftMotors, leftSent, dutyLeft);
+  sendDuty(rightMotors, rightSent, dutyRight);
+
+  commandedDuty = max(dutyLeft, dutyRight);
+}
+
+// PI step rate and tracking error once a second while holding a heading
+void Motors::publishHoldStats()
+{
+  unsigned long elapsed = millis() - holdStatsSince;
+
+  if (elapsed < 1000)
+  {
+    return;
+  }
+
+  HeadingHoldStats stats = headingHold.takeStats();
+  holdStatsSince = millis();
+
+  if (stats.steps == 0)
+  {
+    return;
+  }
+
+  String msg = "target " + String(headingHold.getTarget()) + " rate " + String(stats.steps * 1000 / elapsed) + "/s missed " + String(stats.missed) + " error mean " + String(stats.errorSum / stats.steps) + " max " + String(stats.errorMax) + " trim " + String(stats.trim);
+
+  Log(MQTT_HEADING_HOLD_TOPIC, msg.c_str());
+}
@@ -127,6 +127,11 @@ void MQTT::callback(char *topic, byte *payload, unsigned int length)
       Log("MQTT joyx: " + left_x_mapped);
       Log("MQTT joyy: " + left_y_mapped);
     }
+
+    if (json.containsKey("command") == true)
+    {
+      command = json["command"].as<String>();
+    }
   }
 }
 
@@ -142,6 +147,12 @@ void MQTT::publishMQTTmessage(String topic, String msg)
 
 MotorXY MQTT::Loop()
 {
+  //let PubSubClient deliver anything that has arrived
+  if (MQTTClient.connected() == true)
+  {
+    MQTTClient.loop();
+  }
+
   //take a copy of the local variable
   MotorXY returnValue;
   returnValue.fromMQTT = motorXY.fromMQTT;
@@ -155,3 +166,12 @@ MotorXY MQTT::Loop()
 
   return returnValue;
 }
+
+String MQTT::takeCommand()
+{
+  //hand over the last command once
+  String returnValue = command;
+  command = "";
+
+  return returnValue;
+}
@@ -0,0 +1,32 @@
+#include "nunchuckReport.h"
+
+NunchuckReport decodeNunchuckReport(const uint8_t *buf)
+{
+  uint8_t low = buf[5];
+  NunchuckReport report;
+
+  report.joyX = buf[0];
+  report.joyY = buf[1];
+  report.accelX = (buf[2] << 2) | ((low >> 2) & 0x03);
+  report.accelY = (buf[3] << 2) | ((low >> 4) & 0x03);
+  report.accelZ = (buf[4] << 2) | (low >> 6);
+  report.zButton = ~low & 0x01;
+  report.cButton = (~low >> 1) & 0x01;
+
+  return report;
+}
+
+NunchuckReport idleNunchuckReport()
+{
+  NunchuckReport report;
+
+  report.joyX = NUNCHUCK_JOY_CENTRE;
+  report.joyY = NUNCHUCK_JOY_CENTRE;
+  report.accelX = NUNCHUCK_ACCEL_CENTRE;
+  report.accelY = NUNCHUCK_ACCEL_CENTRE;
+  report.accelZ = NUNCHUCK_ACCEL_CENTRE;
+  report.zButton = 0;
+  report.cButton = 0;
+
+  return report;
+}
@@ -0,0 +1,60 @@
+#include "rangeRate.h"
+#include "leastSquares.h"
+
+RangeRate::RangeRate() : next(0), count(0)
+{
+}
+
+// out of range samples (INT_MAX) start the estimate again, and so does a
+// gap, a slope across it would be taken from ranges that no longer apply
+void RangeRate::add(int rangeMilliMeter, unsigned long timestampMicros)
+{
+  if (rangeMilliMeter == INT_MAX)
+  {
+    reset();
+    return;
+  }
+
+  uint8_t latest = (next + RANGE_RATE_WINDOW - 1) % RANGE_RATE_WINDOW;
+
+  if (count > 0 && timestampMicros - timestamps[latest] > RANGE_RATE_MAX_GAP_US)
+  {
+    reset();
+  }
+
+  ranges[next] = rangeMilliMeter;
+  timestamps[next] = timestampMicros;
+
+  next = (next + 1) % RANGE_RATE_WINDOW;
+
+  if (count < RANGE_RATE_WINDOW)
+  {
+    count++;
+  }
+}
+
+void RangeRate::reset()
+{
+  next = 0;
+  count = 0;
+}
+
+// negated so closing is positive
+long RangeRate::closingSpeed()
+{
+  return -leastSquaresSlope(ranges, timestamps, RANGE_RATE_WINDOW, next, count);
+}
+
+long RangeRate::ttcMillis()
+{
+  long speed = closingSpeed();
+
+  if (speed <= 0)
+  {
+    return RANGE_RATE_NO_COLLISION;
+  }
+
+  long latest = ranges[(next + RANGE_RATE_WINDOW - 1) % RANGE_RATE_WINDOW];
+
+  return (long)((int64_t)latest * 1000 / speed);
+}
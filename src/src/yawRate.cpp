@@ -0,0 +1,52 @@
+#include "yawRate.h"
+#include "leastSquares.h"
+
+YawRate::YawRate() : next(0), count(0)
+{
+}
+
+// heading in degrees, any whole turn offset is fine
+void YawRate::add(int heading, unsigned long timestampMicros)
+{
+  uint8_t latest = (next + YAW_RATE_WINDOW - 1) % YAW_RATE_WINDOW;
+
+  if (count > 0 && timestampMicros - timestamps[latest] > YAW_RATE_MAX_GAP_US)
+  {
+    reset();
+  }
+
+  long unwrapped = heading;
+
+  if (count > 0)
+  {
+    // the step from the last sample, -180..179
+    long step = ((heading - headings[latest]) % 360 + 540) % 360 - 180;
+    unwrapped = headings[latest] + step;
+  }
+
+  headings[next] = unwrapped;
+  timestamps[next] = timestampMicros;
+
+  next = (next + 1) % YAW_RATE_WINDOW;
+
+  if (count < YAW_RATE_WINDOW)
+  {
+    count++;
+  }
+}
+
+void YawRate::reset()
+{
+  next = 0;
+  count = 0;
+}
+
+bool YawRate::ready()
+{
+  return count >= 2;
+}
+
+long YawRate::degreesPerSecond()
+{
+  return leastSquaresSlope(headings, timestamps, YAW_RATE_WINDOW, next, count);
+}
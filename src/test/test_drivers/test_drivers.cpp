@@ -0,0 +1,108 @@
+// the unmodified QMC5883L and LOLIN drivers against the I2CSim models,
+// through the Wire.h shim. `pio test -e native -f test_drivers`
+
+#include <Wire.h>
+#include <unity.h>
+#include "QMC5883L.h"
+#include "LOLIN_I2C_MOTOR.h"
+
+static QMC5883LSim compassSim;
+static LolinMotorSim motorSim(DEFAULT_I2C_MOTOR_ADDRESS);
+
+void setUp(void)
+{
+  Wire.begin();
+}
+
+void tearDown(void)
+{
+}
+
+void test_compass_reads_the_field(void)
+{
+  QMC5883L compass;
+  int16_t x, y, z, t;
+
+  compass.init();
+  compass.setSamplingRate(100);
+
+  compassSim.x = 1234;
+  compassSim.y = -567;
+  compassSim.z = 89;
+
+  TEST_ASSERT_EQUAL(1, compass.readRaw(&x, &y, &z, &t));
+  TEST_ASSERT_EQUAL(1234, x);
+  TEST_ASSERT_EQUAL(-567, y);
+  TEST_ASSERT_EQUAL(89, z);
+}
+
+void test_compass_waits_for_a_new_sample(void)
+{
+  QMC5883L compass;
+  int16_t x, y, z, t;
+
+  compass.init();
+  compass.setSamplingRate(100);
+
+  TEST_ASSERT_EQUAL(1, compass.readRaw(&x, &y, &z, &t));
+
+  // read straight away again, the next sample is 10ms off
+  TEST_ASSERT_EQUAL(0, compass.tryRead(&x, &y, &z, &t));
+
+  Wire.advance(10000);
+  TEST_ASSERT_TRUE(compass.tryRead(&x, &y, &z, &t) & QMC5883L_STATUS_DRDY);
+}
+
+void test_compass_reports_missed_samples(void)
+{
+  QMC5883L compass;
+  int16_t x, y, z, t;
+
+  compass.init();
+  compass.setSamplingRate(100);
+
+  TEST_ASSERT_EQUAL(1, compass.readRaw(&x, &y, &z, &t));
+
+  // three samples go by unread
+  Wire.advance(35000);
+
+  int status = compass.tryRead(&x, &y, &z, &t);
+  TEST_ASSERT_TRUE(status & QMC5883L_STATUS_DRDY);
+  TEST_ASSERT_TRUE(status & QMC5883L_STATUS_DOR);
+
+  // the read cleared both
+  Wire.advance(10000);
+  TEST_ASSERT_EQUAL(QMC5883L_STATUS_DRDY, compass.tryRead(&x, &y, &z, &t));
+}
+
+void test_motor_shield_answers_and_takes_commands(void)
+{
+  LOLIN_I2C_MOTOR motors(DEFAULT_I2C_MOTOR_ADDRESS);
+  unsigned long started = millis();
+
+  TEST_ASSERT_EQUAL(0, motors.getInfo());
+  TEST_ASSERT_EQUAL(PRODUCT_ID_I2C_MOTOR, motors.PRODUCT_ID);
+
+  // the driver's 50ms wait for the reply passes in simulated time
+  TEST_ASSERT_GREATER_OR_EQUAL(50, millis() - started);
+
+  motors.changeDuty(MOTOR_CH_A, 42.5);
+  motors.changeStatus(MOTOR_CH_BOTH, MOTOR_STATUS_CW);
+
+  TEST_ASSERT_EQUAL(4250, motorSim.duty[0]);
+  TEST_ASSERT_EQUAL(MOTOR_STATUS_CW, motorSim.status[0]);
+  TEST_ASSERT_EQUAL(MOTOR_STATUS_CW, motorSim.status[1]);
+}
+
+int main()
+{
+  Wire.attach(compassSim);
+  Wire.attach(motorSim);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_compass_reads_the_field);
+  RUN_TEST(test_compass_waits_for_a_new_sample);
+  RUN_TEST(test_compass_reports_missed_samples);
+  RUN_TEST(test_motor_shield_answers_and_takes_commands);
+  return UNITY_END();
+}
@@ -0,0 +1,241 @@
+// the ellipse fit against synthetic turns with known hard and soft iron,
+// and degenerate samples it has to turn down.
+// `pio test -e native -f test_ellipse_calibration`
+
+#include <math.h>
+#include <unity.h>
+#include "EllipseCalibration.h"
+
+#define FIELD_COUNTS 1500    // earth's field at the 8G range
+#define MAX_HEADING_ERROR 2.0 // degrees
+
+// a car turning in the field, the soft iron is symmetric: scale along an
+// axis at angle, which is also what a tilted sensor sees
+struct Distortion
+{
+  double x0, y0;  // hard iron, counts
+  double angle;   // soft iron axis, degrees
+  double major;   // scale along it
+  double minor;   // and across it
+};
+
+static EllipseCalibration calibration;
+static uint32_t noiseState;
+
+// +-range counts of repeatable noise
+static int noise(int range)
+{
+  noiseState = noiseState * 1103515245 + 12345;
+  return (int)((noiseState >> 16) % (2 * range + 1)) - range;
+}
+
+static void measure(const Distortion &d, double heading, int noiseCounts, int16_t *x, int16_t *y)
+{
+  double h = heading * M_PI / 180;
+  double a = d.angle * M_PI / 180;
+  double fx = FIELD_COUNTS * cos(h), fy = FIELD_COUNTS * sin(h);
+
+  // into the soft iron axes, scale, and back
+  double along = fx * cos(a) + fy * sin(a);
+  double across = -fx * sin(a) + fy * cos(a);
+  along *= d.major;
+  across *= d.minor;
+
+  *x = (int16_t)lround(d.x0 + along * cos(a) - across * sin(a)) + noise(noiseCounts);
+  *y = (int16_t)lround(d.y0 + along * sin(a) + across * cos(a)) + noise(noiseCounts);
+}
+
+// three turns, fitting every ELLIPSE_SOLVE_EVERY samples as the compass does
+static bool turn(const Distortion &d, int noiseCounts)
+{
+  uint32_t solvedAt = 0;
+
+  for (double heading = 0; heading < 3 * 360; heading += 2.5)
+  {
+    int16_t x, y;
+    measure(d, heading, noiseCounts, &x, &y);
+
+    if (calibration.add(x, y) == true && calibration.samples() - solvedAt >= ELLIPSE_SOLVE_EVERY)
+    {
+      solvedAt = calibration.samples();
+      calibration.solve();
+    }
+  }
+
+  return calibration.solve();
+}
+
+// worst heading error of the calibrated, noise free field all the way round
+static double worstHeadingError(const Distortion &d)
+{
+  double worst = 0;
+
+  for (int heading = 0; heading < 360; heading++)
+  {
+    int16_t x, y;
+    int32_t u, v;
+    measure(d, heading, 0, &x, &y);
+    calibration.apply(x, y, &u, &v);
+
+    double error = fabs(fmod(atan2(v, u) * 180 / M_PI - heading + 540, 360) - 180);
+    worst = fmax(worst, error);
+  }
+
+  return worst;
+}
+
+static void assertIdentity()
+{
+  int32_t u, v;
+  calibration.apply(1234, -567, &u, &v);
+  TEST_ASSERT_EQUAL(1234, u);
+  TEST_ASSERT_EQUAL(-567, v);
+}
+
+void setUp(void)
+{
+  calibration.reset();
+  noiseState = 1;
+}
+
+void tearDown(void)
+{
+}
+
+void test_uncalibrated_is_off_by_more_than_the_limit(void)
+{
+  // makes sure the cases below need the fit to pass
+  Distortion d = {600, -900, 30, 1.3, 0.8};
+
+  TEST_ASSERT_FALSE(calibration.valid());
+  TEST_ASSERT_GREATER_THAN_FLOAT(10 * MAX_HEADING_ERROR, worstHeadingError(d));
+}
+
+void test_hard_iron_offset(void)
+{
+  Distortion d = {600, -900, 0, 1, 1};
+
+  TEST_ASSERT_TRUE(turn(d, 2));
+  TEST_ASSERT_LESS_THAN_FLOAT(MAX_HEADING_ERROR, worstHeadingError(d));
+}
+
+void test_hard_iron_outside_the_turn(void)
+{
+  // the origin outside the ellipse, the conic comes out negated
+  Distortion d = {2500, 1800, 0, 1, 1};
+
+  TEST_ASSERT_TRUE(turn(d, 2));
+  TEST_ASSERT_LESS_THAN_FLOAT(MAX_HEADING_ERROR, worstHeadingError(d));
+}
+
+void test_tilted_sensor(void)
+{
+  // 40 degrees of tilt about an axis 25 degrees off x
+  Distortion d = {0, 0, 25, 1, cos(40 * M_PI / 180)};
+
+  TEST_ASSERT_TRUE(turn(d, 2));
+  TEST_ASSERT_LESS_THAN_FLOAT(MAX_HEADING_ERROR, worstHeadingError(d));
+}
+
+void test_soft_and_hard_iron(void)
+{
+  Distortion d = {-700, 450, -60, 1.4, 0.75};
+
+  TEST_ASSERT_TRUE(turn(d, 3));
+  TEST_ASSERT_LESS_THAN_FLOAT(MAX_HEADING_ERROR, worstHeadingError(d));
+}
+
+void test_partial_arc_is_not_fitted(void)
+{
+  Distortion d = {600, -900, 30, 1.3, 0.8};
+
+  for (double heading = 0; heading < 200; heading += 2.5)
+  {
+    int16_t x, y;
+    measure(d, heading, 2, &x, &y);
+    calibration.add(x, y);
+  }
+
+  TEST_ASSERT_FALSE(calibration.solve());
+  TEST_ASSERT_FALSE(calibration.valid());
+  assertIdentity();
+}
+
+void test_parked_car_is_not_fitted(void)
+{
+  for (int i = 0; i < 1000; i++)
+  {
+    calibration.add(300 + noise(3), -200 + noise(3));
+  }
+
+  TEST_ASSERT_EQUAL(1, calibration.samples());
+  TEST_ASSERT_FALSE(calibration.solve());
+  TEST_ASSERT_FALSE(calibration.valid());
+  assertIdentity();
+}
+
+// samples on the two diagonals y = x and y = -x, in an order that still
+// reaches all eight octants of their bounds, have x^2 == y^2 every time,
+// so the normal equations are singular
+static void addDiagonals()
+{
+  for (int i = 0; i < 256; i++)
+  {
+    int t = 40 + (noise(1000) + 1000) % 1960;
+    int arm = noise(2) + 2;
+    calibration.add((arm & 1) ? -t : t, (arm & 2) ? -t : t);
+  }
+}
+
+void test_singular_normal_equations_are_not_fitted(void)
+{
+  addDiagonals();
+
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ELLIPSE_MIN_SAMPLES, calibration.samples());
+  TEST_ASSERT_FALSE(calibration.solve());
+  TEST_ASSERT_FALSE(calibration.valid());
+  assertIdentity();
+}
+
+void test_straight_line_is_not_fitted(void)
+{
+  for (int x = -2000; x <= 2000; x += 20)
+  {
+    calibration.add(x, x / 2 + 100);
+  }
+
+  TEST_ASSERT_FALSE(calibration.solve());
+  TEST_ASSERT_FALSE(calibration.valid());
+  assertIdentity();
+}
+
+void test_failed_fit_keeps_the_saved_calibration(void)
+{
+  const int16_t saved[4] = {4096, -300, -300, 3500};
+  int16_t x0, y0, m[4];
+
+  calibration.set(120, -80, saved);
+  addDiagonals();
+
+  TEST_ASSERT_TRUE(calibration.solve());
+  calibration.get(&x0, &y0, m);
+  TEST_ASSERT_EQUAL(120, x0);
+  TEST_ASSERT_EQUAL(-80, y0);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(saved, m, 4);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_uncalibrated_is_off_by_more_than_the_limit);
+  RUN_TEST(test_hard_iron_offset);
+  RUN_TEST(test_hard_iron_outside_the_turn);
+  RUN_TEST(test_tilted_sensor);
+  RUN_TEST(test_soft_and_hard_iron);
+  RUN_TEST(test_partial_arc_is_not_fitted);
+  RUN_TEST(test_parked_car_is_not_fitted);
+  RUN_TEST(test_singular_normal_equations_are_not_fitted);
+  RUN_TEST(test_straight_line_is_not_fitted);
+  RUN_TEST(test_failed_fit_keeps_the_saved_calibration);
+  return UNITY_END();
+}
@@ -0,0 +1,118 @@
+// the heading hold's PI steps: one per period on a fixed grid, no replays
+// of an old heading. `pio test -e native -f test_heading_hold`
+
+#include <unity.h>
+#include "headingHold.h"
+
+static HeadingHold headingHold;
+
+void setUp(void)
+{
+  headingHold = HeadingHold();
+}
+
+void tearDown(void)
+{
+}
+
+void test_steps_once_per_period(void)
+{
+  headingHold.hold(HEADING_HOLD_NORTH, 100, 1000);
+
+  // called every millisecond with a new heading each time
+  for (unsigned long now = 1000; now < 1000 + 10 * HEADING_HOLD_PERIOD_MS; now++)
+  {
+    headingHold.step(100, now * 1000, now);
+  }
+
+  HeadingHoldStats stats = headingHold.takeStats();
+  TEST_ASSERT_EQUAL(10, stats.steps);
+  TEST_ASSERT_EQUAL(0, stats.missed);
+}
+
+void test_late_call_steps_once_and_keeps_the_grid(void)
+{
+  headingHold.hold(HEADING_HOLD_NORTH, 100, 1000);
+  TEST_ASSERT_TRUE(headingHold.step(100, 1, 1000));
+
+  // four and a half periods late: one step, the three periods in between are dropped
+  TEST_ASSERT_TRUE(headingHold.step(100, 2, 1000 + 4 * HEADING_HOLD_PERIOD_MS + HEADING_HOLD_PERIOD_MS / 2));
+  TEST_ASSERT_FALSE(headingHold.step(100, 3, 1000 + 5 * HEADING_HOLD_PERIOD_MS - 1));
+  TEST_ASSERT_TRUE(headingHold.step(100, 3, 1000 + 5 * HEADING_HOLD_PERIOD_MS));
+
+  HeadingHoldStats stats = headingHold.takeStats();
+  TEST_ASSERT_EQUAL(3, stats.steps);
+  TEST_ASSERT_EQUAL(3, stats.missed);
+}
+
+void test_old_heading_is_not_stepped_on_again(void)
+{
+  headingHold.hold(HEADING_HOLD_NORTH, 100, 1000);
+  TEST_ASSERT_TRUE(headingHold.step(90, 1, 1000));
+  int trim = headingHold.getTrim();
+
+  // the compass has nothing new for the next period
+  TEST_ASSERT_FALSE(headingHold.step(90, 1, 1000 + HEADING_HOLD_PERIOD_MS));
+  TEST_ASSERT_EQUAL(trim, headingHold.getTrim());
+
+  HeadingHoldStats stats = headingHold.takeStats();
+  TEST_ASSERT_EQUAL(1, stats.steps);
+  TEST_ASSERT_EQUAL(1, stats.missed);
+}
+
+void test_integral_grows_one_period_per_step(void)
+{
+  // the same 10 degree error for 20 steps, however late the calls come,
+  // gives the same trim as 20 calls on time
+  HeadingHold onTime, late;
+  onTime.hold(HEADING_HOLD_NORTH, 100, 0);
+  late.hold(HEADING_HOLD_NORTH, 100, 0);
+
+  for (unsigned long i = 0; i < 20; i++)
+  {
+    onTime.step(110, i + 1, i * HEADING_HOLD_PERIOD_MS);
+    late.step(110, i + 1, i * 3 * HEADING_HOLD_PERIOD_MS);
+  }
+
+  TEST_ASSERT_EQUAL(20, late.takeStats().steps);
+  TEST_ASSERT_EQUAL(onTime.getTrim(), late.getTrim());
+  TEST_ASSERT_TRUE(onTime.getTrim() < 0);
+}
+
+void test_reversing_flips_the_trim(void)
+{
+  HeadingHold south;
+  headingHold.hold(HEADING_HOLD_NORTH, 100, 0);
+  south.hold(HEADING_HOLD_SOUTH, 100, 0);
+
+  headingHold.step(95, 1, 0);
+  south.step(95, 1, 0);
+
+  TEST_ASSERT_TRUE(headingHold.getTrim() > 0);
+  TEST_ASSERT_EQUAL(-headingHold.getTrim(), south.getTrim());
+}
+
+void test_no_steps_without_a_heading_to_hold(void)
+{
+  TEST_ASSERT_FALSE(headingHold.step(100, 1, 0));
+
+  headingHold.hold(HEADING_HOLD_NORTH, 0, 0); // no compass
+  TEST_ASSERT_FALSE(headingHold.step(100, 1, 0));
+
+  headingHold.hold(HEADING_HOLD_NORTH, 100, 0);
+  headingHold.hold(HEADING_HOLD_OFF, 100, 10);
+  TEST_ASSERT_FALSE(headingHold.step(100, 2, HEADING_HOLD_PERIOD_MS));
+  TEST_ASSERT_EQUAL(0, headingHold.getTrim());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_steps_once_per_period);
+  RUN_TEST(test_late_call_steps_once_and_keeps_the_grid);
+  RUN_TEST(test_old_heading_is_not_stepped_on_again);
+  RUN_TEST(test_integral_grows_one_period_per_step);
+  RUN_TEST(test_reversing_flips_the_trim);
+  RUN_TEST(test_no_steps_without_a_heading_to_hold);
+  return UNITY_END();
+}
@@ -0,0 +1,120 @@
+// I2CBus::Loop and recover against a compass model holding SDA low.
+// `pio test -e native -f test_i2c_recovery`
+
+#include <Wire.h>
+#include <unity.h>
+#include "i2cBus.h"
+
+static QMC5883LSim compassSim;
+static I2CBus i2cBus;
+static int recoveries;
+
+static uint32_t clocksBefore, startsBefore, stopsBefore;
+
+void setUp(void)
+{
+  Wire.begin();
+  Wire.sdaHoldClocks = I2CSIM_HOLD_CLOCKS;
+  recoveries = 0;
+}
+
+void tearDown(void)
+{
+  Wire.clockOut();
+}
+
+// a write the compass answers by holding SDA, as a slave stuck mid byte
+static void lockUp()
+{
+  compassSim.injectFault(I2CSIM_FAULT_HOLD_SDA);
+
+  Wire.beginTransmission(I2C_ADDRESS_COMPASS);
+  Wire.write((uint8_t)0x00);
+  TEST_ASSERT_EQUAL(4, Wire.endTransmission());
+  TEST_ASSERT_EQUAL(LOW, digitalRead(SDA));
+
+  clocksBefore = Wire.sclClocks;
+  startsBefore = Wire.starts;
+  stopsBefore = Wire.stops;
+}
+
+// the watchdog waits for I2C_STUCK_CHECKS idle checks before it recovers
+static bool watchdog()
+{
+  for (int i = 1; i < I2C_STUCK_CHECKS; i++)
+  {
+    TEST_ASSERT_FALSE(i2cBus.Loop());
+  }
+
+  return i2cBus.Loop();
+}
+
+void test_worst_case_hold_recovers_in_nine_clocks(void)
+{
+  lockUp();
+
+  TEST_ASSERT_TRUE(watchdog());
+  TEST_ASSERT_EQUAL(I2CSIM_OK, Wire.status());
+  TEST_ASSERT_EQUAL(HIGH, digitalRead(SDA));
+  TEST_ASSERT_EQUAL(1, recoveries);
+
+  // at most nine to free the slave, and one for the stop
+  TEST_ASSERT_LESS_OR_EQUAL(9 + 1, Wire.sclClocks - clocksBefore);
+}
+
+void test_recovery_stops_clocking_once_sda_is_released(void)
+{
+  Wire.sdaHoldClocks = 3;
+  lockUp();
+
+  TEST_ASSERT_TRUE(watchdog());
+  TEST_ASSERT_EQUAL(3 + 1, Wire.sclClocks - clocksBefore);
+  TEST_ASSERT_EQUAL(1, recoveries);
+}
+
+void test_recovery_ends_with_a_stop_and_no_start(void)
+{
+  lockUp();
+
+  TEST_ASSERT_TRUE(i2cBus.recover());
+  TEST_ASSERT_EQUAL(0, Wire.starts - startsBefore);
+  TEST_ASSERT_EQUAL(1, Wire.stops - stopsBefore);
+}
+
+void test_bus_works_after_recovery(void)
+{
+  lockUp();
+
+  TEST_ASSERT_TRUE(i2cBus.recover());
+
+  Wire.beginTransmission(I2C_ADDRESS_COMPASS);
+  Wire.write((uint8_t)0x0D);
+  TEST_ASSERT_EQUAL(0, Wire.endTransmission());
+  TEST_ASSERT_EQUAL(1, Wire.requestFrom(I2C_ADDRESS_COMPASS, 1));
+  TEST_ASSERT_EQUAL(0xFF, Wire.read());
+}
+
+void test_still_stuck_bus_runs_no_handlers(void)
+{
+  Wire.sdaHoldClocks = 200;
+  lockUp();
+
+  TEST_ASSERT_FALSE(watchdog());
+  TEST_ASSERT_EQUAL(9 + 1, Wire.sclClocks - clocksBefore);
+  TEST_ASSERT_EQUAL(I2CSIM_SDA_HELD_LOW, Wire.status());
+  TEST_ASSERT_EQUAL(0, recoveries);
+}
+
+int main()
+{
+  Wire.attach(compassSim);
+  i2cBus.onRecovery([]() { recoveries++; });
+
+  UNITY_BEGIN();
+  RUN_TEST(test_worst_case_hold_recovers_in_nine_clocks);
+  RUN_TEST(test_recovery_stops_clocking_once_sda_is_released);
+  RUN_TEST(test_recovery_ends_with_a_stop_and_no_start);
+  RUN_TEST(test_bus_works_after_recovery);
+  RUN_TEST(test_still_stuck_bus_runs_no_handlers);
+  return UNITY_END();
+}
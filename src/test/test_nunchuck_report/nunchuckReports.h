@@ -0,0 +1,48 @@
+#ifndef NunchuckReports_h
+
+#define NunchuckReports_h
+
+#include <stdint.h>
+
+/*
+   Nunchuck reports as they come off the bus, still encrypted by the 0x40
+   0x00 handshake, with the stick, accelerometer and button values in them.
+
+   These are not hardware captures. Each one was worked out by hand from
+   the report layout on WiiBrew (wiibrew.org/wiki/Wiimote/Extension_Controllers/Nunchuck):
+   byte 5 carries Z in bit 0 and C in bit 1, low when pressed, then the
+   low two bits of accelerometer x, y and z in that order. Each byte was
+   then encrypted as (value - 0x17) ^ 0x17. The values are in the ranges a
+   real nunchuck reports: the stick goes from about 0x1D to 0xE2, and
+   resting level gives about 1g, some 200 counts above 512, on z. None of
+   this comes from NunchuckSim, so it checks the decode independently.
+
+   A report recorded with -D I2C_CAPTURE (a 6 byte read from 0x52) can be
+   added as a row once its values are known, the bytes as read. The same
+   12 hex digits are what tools/nunchuck_decode takes.
+*/
+struct NunchuckFixture
+{
+  const char *name;
+  uint8_t wire[6];
+  uint8_t joyX, joyY;
+  uint16_t accelX, accelY, accelZ;
+  uint8_t zButton, cButton; // 1 when pressed
+};
+
+static const NunchuckFixture nunchuckReports[] = {
+  {"resting on the table, stick centred", {0x7E, 0x7F, 0x72, 0x7B, 0x8C, 0x53}, 0x80, 0x7F, 498, 525, 713, 0, 0},
+  {"stick pushed fully forward", {0x70, 0xDC, 0x71, 0x7C, 0x8D, 0x53}, 0x7E, 0xE2, 502, 521, 709, 0, 0},
+  {"stick pushed fully back", {0x7D, 0x1F, 0x73, 0x7A, 0x8B, 0xEF}, 0x81, 0x1F, 495, 528, 716, 0, 0},
+  {"stick fully left", {0x11, 0x7E, 0x71, 0x7B, 0x8D, 0xBB}, 0x1D, 0x80, 500, 524, 711, 0, 0},
+  {"stick fully right and back", {0xDE, 0x1C, 0x72, 0x7B, 0x8C, 0x87}, 0xE0, 0x22, 497, 526, 714, 0, 0},
+  {"z pressed", {0x7E, 0x7F, 0x72, 0x7C, 0x8C, 0x30}, 0x80, 0x7F, 499, 523, 712, 1, 0},
+  {"c pressed", {0x7E, 0x7F, 0x71, 0x7B, 0x8D, 0x69}, 0x80, 0x7F, 501, 525, 710, 0, 1},
+  {"z and c pressed, stick forward left", {0x04, 0xA8, 0x72, 0x7B, 0x8C, 0x4E}, 0x2A, 0xD6, 496, 527, 713, 1, 1},
+  {"rolled onto its right side", {0x7E, 0x7F, 0x8C, 0x7D, 0x71, 0xF7}, 0x80, 0x7F, 713, 519, 503, 0, 0},
+  {"pointing at the floor", {0x7F, 0x7E, 0x70, 0x23, 0x7E, 0xA7}, 0x7F, 0x80, 505, 300, 515, 0, 0},
+  {"accelerometer at both ends of its range", {0xFE, 0xFF, 0xFE, 0xFF, 0x7E, 0x8C}, 0x00, 0xFF, 0, 1023, 514, 1, 0},
+  {"every low accelerometer bit different", {0x29, 0x84, 0x85, 0x28, 0xCD, 0x99}, 0x55, 0xAA, 677, 346, 966, 0, 1},
+};
+
+#endif
@@ -0,0 +1,72 @@
+// decodeNunchuckReport against fixed reports with known stick, button and
+// accelerometer values, see nunchuckReports.h. `pio test -e native -f test_nunchuck_report`
+
+#include <unity.h>
+#include "nunchuckReport.h"
+#include "nunchuckReports.h"
+
+// as Nunchuck::nunchuk_decode_byte
+static uint8_t decodeByte(uint8_t x)
+{
+  return (x ^ 0x17) + 0x17;
+}
+
+static NunchuckReport decodeWire(const uint8_t *wire)
+{
+  uint8_t buf[6];
+
+  for (int i = 0; i < 6; i++)
+  {
+    buf[i] = decodeByte(wire[i]);
+  }
+
+  return decodeNunchuckReport(buf);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_fixtures_decode_to_their_values(void)
+{
+  for (size_t i = 0; i < sizeof(nunchuckReports) / sizeof(nunchuckReports[0]); i++)
+  {
+    const NunchuckFixture &fixture = nunchuckReports[i];
+    NunchuckReport report = decodeWire(fixture.wire);
+
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(fixture.joyX, report.joyX, fixture.name);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(fixture.joyY, report.joyY, fixture.name);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(fixture.accelX, report.accelX, fixture.name);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(fixture.accelY, report.accelY, fixture.name);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(fixture.accelZ, report.accelZ, fixture.name);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(fixture.zButton, report.zButton, fixture.name);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(fixture.cButton, report.cButton, fixture.name);
+  }
+}
+
+void test_resting_report_is_near_idle(void)
+{
+  // the idle report stands in for a missing nunchuck, a real one at rest
+  // has to land close to it on the stick and the level axes
+  NunchuckReport resting = decodeWire(nunchuckReports[0].wire);
+  NunchuckReport idle = idleNunchuckReport();
+
+  TEST_ASSERT_INT_WITHIN(4, idle.joyX, resting.joyX);
+  TEST_ASSERT_INT_WITHIN(4, idle.joyY, resting.joyY);
+  TEST_ASSERT_INT_WITHIN(32, idle.accelX, resting.accelX);
+  TEST_ASSERT_INT_WITHIN(32, idle.accelY, resting.accelY);
+  TEST_ASSERT_EQUAL(0, idle.zButton);
+  TEST_ASSERT_EQUAL(0, idle.cButton);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fixtures_decode_to_their_values);
+  RUN_TEST(test_resting_report_is_near_idle);
+  return UNITY_END();
+}
@@ -0,0 +1,247 @@
+/*
+   atan2_bench - accuracy and cost of fastAtan2Tenths (lib/QMC5883L/FastAtan2.h)
+   against the float atan2 QMC5883L::readHeading used to compute with.
+
+   Build from the project directory:
+     g++ -O2 -std=c++11 -Ilib/QMC5883L tools/atan2_bench/atan2_bench.cpp -o atan2_bench
+
+   Prints one "name value" line per result and exits non-zero when any
+   check is out by more than the 0.15 degrees FastAtan2.h promises.
+
+   The accuracy checks cover every int16 magnitude pair in the first octant
+   (0 <= y <= x <= 32768, about 5.4e8 of them, where the polynomial does all
+   its work), every int16 point on an axis or a diagonal and one either side
+   of it in all eight octants (where the folding and unfolding can go
+   wrong), every x,y pair on a grid of step 7 (both ends included), a circle
+   of radius 32767 every thousandth of a degree and the int32 products
+   QMC5883L::computeHeading passes in. Errors are circular, in degrees. The
+   whole run takes some seconds.
+
+   The timings are for the host only and say nothing about the car: a host
+   FPU makes float atan2 cheap, the ESP8266 does it in software. Build the
+   firmware with -D ATAN2_BENCHMARK for cycle counts on the car.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include "FastAtan2.h"
+
+#define MAX_ERROR_DEG 0.15 // as promised in FastAtan2.h
+
+struct Error
+{
+  double max;
+  double sum;
+  uint64_t count;
+  int32_t worstY, worstX;
+};
+
+static void check(Error &error, int32_t y, int32_t x)
+{
+  if (x == 0 && y == 0)
+  {
+    return;
+  }
+
+  double expected = atan2((double)y, (double)x) * 180.0 / M_PI;
+  double diff = fastAtan2Tenths(y, x) / 10.0 - expected;
+
+  diff = fmod(diff + 540.0, 360.0) - 180.0;
+  diff = fabs(diff);
+
+  if (diff > error.max)
+  {
+    error.max = diff;
+    error.worstY = y;
+    error.worstX = x;
+  }
+  error.sum += diff;
+  error.count++;
+}
+
+static int failures = 0;
+
+static void report(const char *name, const Error &error)
+{
+  printf("%s_points %llu\n", name, (unsigned long long)error.count);
+  printf("%s_max_error_deg %.4f\n", name, error.max);
+  printf("%s_mean_error_deg %.4f\n", name, error.sum / error.count);
+  printf("%s_worst %d,%d\n", name, error.worstY, error.worstX);
+
+  if (error.max > MAX_ERROR_DEG)
+  {
+    printf("%s FAIL over %.2f deg\n", name, MAX_ERROR_DEG);
+    failures++;
+  }
+}
+
+// a point and its mirror images in all eight octants
+static void checkOctants(Error &error, int32_t a, int32_t b)
+{
+  const int32_t points[8][2] = {{a, b}, {b, a}, {-a, b}, {-b, a}, {a, -b}, {b, -a}, {-a, -b}, {-b, -a}};
+
+  for (int i = 0; i < 8; i++)
+  {
+    // mirroring -32768 leaves the int16 range
+    if (points[i][0] < -32768 || points[i][0] > 32767 || points[i][1] < -32768 || points[i][1] > 32767)
+    {
+      continue;
+    }
+
+    check(error, points[i][0], points[i][1]);
+  }
+}
+
+// steps of 7 through the int16 range, always finishing on 32767
+static int32_t nextGrid(int32_t v)
+{
+  if (v == 32767)
+  {
+    return 32768;
+  }
+
+  return v + 7 > 32767 ? 32767 : v + 7;
+}
+
+static double seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the heading as QMC5883L::readHeading computed it before, degrees
+static int floatHeading(int16_t x, int16_t y, int16_t xRange, int16_t yRange)
+{
+  float fx = (float)x / xRange;
+  float fy = (float)y / yRange;
+
+  int heading = 180.0 * atan2(fy, fx) / M_PI;
+  if (heading <= 0)
+  {
+    heading += 360;
+  }
+
+  return heading;
+}
+
+// the same through fastAtan2Tenths, as QMC5883L::computeHeading
+static int fixedHeading(int16_t x, int16_t y, int16_t xRange, int16_t yRange)
+{
+  int heading = (fastAtan2Tenths((int32_t)y * xRange, (int32_t)x * yRange) + 5) / 10;
+  if (heading <= 0)
+  {
+    heading += 360;
+  }
+
+  return heading;
+}
+
+int main()
+{
+  // the octants are exact reflections of the first one, so this covers the
+  // polynomial and the division for every int16 input
+  Error octant = {0, 0, 0, 0, 0};
+  for (int32_t x = 1; x <= 32768; x++)
+  {
+    for (int32_t y = 0; y <= x; y++)
+    {
+      check(octant, y, x);
+    }
+  }
+  report("int16_first_octant", octant);
+
+  Error edges = {0, 0, 0, 0, 0};
+  for (int32_t m = -32768; m <= 32767; m++)
+  {
+    for (int32_t d = -1; d <= 1; d++)
+    {
+      checkOctants(edges, m, d);     // the axes
+      checkOctants(edges, m, m + d); // the diagonals
+    }
+  }
+  report("int16_edges", edges);
+
+  Error grid = {0, 0, 0, 0, 0};
+  for (int32_t y = -32768; y <= 32767; y = nextGrid(y))
+  {
+    for (int32_t x = -32768; x <= 32767; x = nextGrid(x))
+    {
+      check(grid, y, x);
+    }
+  }
+  report("int16_grid", grid);
+
+  Error circle = {0, 0, 0, 0, 0};
+  for (int i = 0; i < 360000; i++)
+  {
+    double angle = i / 1000.0 * M_PI / 180.0;
+    check(circle, lround(32767 * sin(angle)), lround(32767 * cos(angle)));
+  }
+  report("circle", circle);
+
+  Error products = {0, 0, 0, 0, 0};
+  srand(1);
+  for (int i = 0; i < 1000000; i++)
+  {
+    int32_t xRange = 1 + rand() % 32767;
+    int32_t yRange = 1 + rand() % 32767;
+    int32_t x = rand() % (xRange + 1) - xRange / 2;
+    int32_t y = rand() % (yRange + 1) - yRange / 2;
+    check(products, y * xRange, x * yRange);
+  }
+  report("products", products);
+
+  // cost, over the same random samples for both
+  const int n = 1 << 16;
+  const int rounds = 200;
+  std::vector<int16_t> xs(n), ys(n);
+  for (int i = 0; i < n; i++)
+  {
+    xs[i] = rand() % 4001 - 2000;
+    ys[i] = rand() % 4001 - 2000;
+  }
+
+  volatile int sink = 0;
+  double started = seconds();
+  for (int r = 0; r < rounds; r++)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      sink += floatHeading(xs[i], ys[i], 4000, 3800);
+    }
+  }
+  double floatNs = (seconds() - started) * 1e9 / ((double)n * rounds);
+
+  started = seconds();
+  for (int r = 0; r < rounds; r++)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      sink += fixedHeading(xs[i], ys[i], 4000, 3800);
+    }
+  }
+  double fixedNs = (seconds() - started) * 1e9 / ((double)n * rounds);
+
+  int differ = 0;
+  for (int i = 0; i < n; i++)
+  {
+    // the float version truncates where the fixed one rounds
+    int diff = abs(floatHeading(xs[i], ys[i], 4000, 3800) - fixedHeading(xs[i], ys[i], 4000, 3800));
+    if (diff > 1 && diff < 359)
+    {
+      differ++;
+    }
+  }
+
+  printf("host_float_heading_ns %.2f\n", floatNs);
+  printf("host_fixed_heading_ns %.2f\n", fixedNs);
+  printf("host_speedup %.2f\n", floatNs / fixedNs);
+  printf("headings_more_than_1deg_apart %d\n", differ);
+
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/*
+   ellipse_sim - heading error of the min/max and ellipse fit compass
+   calibrations in lib/QMC5883L against synthetic distorted fields.
+
+   Build from the project directory:
+     g++ -O2 -std=c++11 -Ilib/QMC5883L tools/ellipse_sim/ellipse_sim.cpp lib/QMC5883L/EllipseCalibration.cpp -o ellipse_sim
+
+   Prints CSV: field,spikes,minmax_error_deg,ellipse_error_deg,fitted
+
+   Each field is a level earth field of 3000 counts turned through a few
+   random full circles, distorted by a soft iron matrix and a hard iron
+   offset, with a count or two of noise, once clean and once with the odd
+   wild sample. The errors
+   are the worst deviation from the true heading over a full turn once the
+   calibration has seen the samples, after removing the constant offset
+   neither calibration can know about.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "FastAtan2.h"
+#include "EllipseCalibration.h"
+
+struct Field
+{
+  const char *name;
+  double s[4];   // soft iron, row major
+  double offset[2];
+};
+
+static const Field fields[] = {
+    {"clean", {1, 0, 0, 1}, {0, 0}},
+    {"hard_iron", {1, 0, 0, 1}, {1800, -900}},
+    {"scaled", {1.4, 0, 0, 0.8}, {600, 300}},
+    {"rotated_soft_iron", {1.2, 0.35, 0.35, 0.7}, {-1200, 500}},
+    {"strong_soft_iron", {1.6, 0.6, 0.2, 0.6}, {300, -2500}},
+};
+
+static double noise()
+{
+  return (rand() % 2001 - 1000) / 1000.0 * 2;
+}
+
+static void distort(const Field &field, double heading, int16_t *x, int16_t *y)
+{
+  double fx = 3000 * cos(heading);
+  double fy = 3000 * sin(heading);
+
+  *x = lround(field.s[0] * fx + field.s[1] * fy + field.offset[0] + noise());
+  *y = lround(field.s[2] * fx + field.s[3] * fy + field.offset[1] + noise());
+}
+
+// as QMC5883L::computeHeading without the ellipse
+static double minMaxHeading(int16_t x, int16_t y, int16_t xlow, int16_t xhigh, int16_t ylow, int16_t yhigh)
+{
+  x -= (xhigh + xlow) / 2;
+  y -= (yhigh + ylow) / 2;
+  return fastAtan2Tenths((int32_t)y * (xhigh - xlow), (int32_t)x * (yhigh - ylow)) / 10.0;
+}
+
+static double ellipseHeading(EllipseCalibration &ellipse, int16_t x, int16_t y)
+{
+  int32_t u, v;
+  ellipse.apply(x, y, &u, &v);
+  return fastAtan2Tenths(v, u) / 10.0;
+}
+
+static double wrap(double degrees)
+{
+  return fmod(fmod(degrees, 360.0) + 540.0, 360.0) - 180.0;
+}
+
+// worst error over a turn after taking out the mean offset
+template <class HeadingOf>
+static double worstError(const Field &field, HeadingOf headingOf)
+{
+  double errors[360];
+  double sinSum = 0, cosSum = 0;
+
+  for (int d = 0; d < 360; d++)
+  {
+    int16_t x, y;
+    distort(field, d * M_PI / 180, &x, &y);
+    errors[d] = wrap(headingOf(x, y) - d);
+    sinSum += sin(errors[d] * M_PI / 180);
+    cosSum += cos(errors[d] * M_PI / 180);
+  }
+
+  double offset = atan2(sinSum, cosSum) * 180 / M_PI;
+  double worst = 0;
+
+  for (int d = 0; d < 360; d++)
+  {
+    worst = fmax(worst, fabs(wrap(errors[d] - offset)));
+  }
+
+  return worst;
+}
+
+int main()
+{
+  srand(1);
+
+  printf("field,spikes,minmax_error_deg,ellipse_error_deg,fitted\n");
+
+  for (int spikes = 0; spikes <= 1; spikes++)
+  {
+    for (const Field &field : fields)
+    {
+      EllipseCalibration ellipse;
+      int16_t xlow = 32767, xhigh = -32768, ylow = 32767, yhigh = -32768;
+      double heading = 0;
+
+      // three turns at a wobbly rate, 100Hz samples
+      for (int i = 0; i < 3000; i++)
+      {
+        heading += (0.5 + (rand() % 100) / 100.0) * 2 * M_PI / 1000;
+
+        int16_t x, y;
+        distort(field, heading, &x, &y);
+
+        // an interference spike now and then
+        if (spikes == 1 && rand() % 500 == 0)
+        {
+          x += 1500;
+        }
+
+        if (x < xlow) xlow = x;
+        if (x > xhigh) xhigh = x;
+        if (y < ylow) ylow = y;
+        if (y > yhigh) yhigh = y;
+
+        if (ellipse.add(x, y) && ellipse.samples() % ELLIPSE_SOLVE_EVERY == 0)
+        {
+          ellipse.solve();
+        }
+      }
+
+      double minMax = worstError(field, [&](int16_t x, int16_t y) { return minMaxHeading(x, y, xlow, xhigh, ylow, yhigh); });
+      double fitted = worstError(field, [&](int16_t x, int16_t y) { return ellipseHeading(ellipse, x, y); });
+
+      if (ellipse.valid() == false)
+      {
+        printf("%s,%d,%.2f,,0\n", field.name, spikes, minMax);
+        continue;
+      }
+
+      printf("%s,%d,%.2f,%.2f,1\n", field.name, spikes, minMax, fitted);
+    }
+  }
+
+  return 0;
+}
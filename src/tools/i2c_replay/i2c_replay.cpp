@@ -0,0 +1,415 @@
+/*
+   i2c_replay - replay an I2C capture dumped by the firmware (-D I2C_CAPTURE,
+   {"command":"i2c_capture_dump"}) against the I2CSim device models.
+
+   Build from the project directory:
+     g++ -O2 -std=gnu++11 -DARDUINO=10800 -Ilib/I2CSim -Ilib/QMC5883L tools/i2c_replay/i2c_replay.cpp lib/I2CSim/I2CSim.cpp lib/I2CSim/Arduino.cpp lib/I2CSim/Wire.cpp lib/QMC5883L/QMC5883L.cpp lib/QMC5883L/EllipseCalibration.cpp -o i2c_replay
+
+   Run with the serial log or `mosquitto_sub -v -t <capture topic>` output:
+     ./i2c_replay [--clock 400000] capture.txt
+     ./i2c_replay --compass capture.txt
+
+   By default this is a replay of the bus traffic only: the recorded writes and
+   reads are issued as they were, but the device models answer them, not the
+   recorded bytes, and no driver code runs. Transactions start at their
+   recorded times, or as soon as the bus is free if it is still busy with the
+   previous one, so replaying at another clock shows how much bus time and
+   lateness a traffic pattern costs.
+
+   --compass feeds the recorded compass bytes through the firmware's QMC5883L
+   driver instead, on the Wire.h shim: every recorded read loads the registers
+   it saw into a register image, and each new sample in it is read back with
+   QMC5883L::tryRead and computeHeading, printed as CSV.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <Wire.h>
+#include "I2CSim.h"
+#include "QMC5883L.h"
+
+#define I2C_CAPTURE_MAX_DATA 16 // as include/i2cCapture.h
+#define COMPASS_ADDRESS 0x0D
+#define COMPASS_STATUS 6
+
+struct Record
+{
+  uint64_t at; // microseconds from the first record
+  uint8_t address;
+  bool read;
+  uint8_t result;
+  uint8_t len;
+  uint8_t data[I2C_CAPTURE_MAX_DATA];
+};
+
+struct DeviceStats
+{
+  uint32_t transactions;
+  uint32_t bytes;
+  uint64_t busMicros;
+  uint32_t mismatches;
+};
+
+// a device that answers with the register contents the capture saw
+class CapturedRegisters : public I2CSimDevice
+{
+public:
+  CapturedRegisters(uint8_t address) : I2CSimDevice(address), pointer(0)
+  {
+    memset(registers, 0, sizeof(registers));
+  }
+
+  uint8_t registers[256];
+  uint8_t pointer;
+
+  void received(const uint8_t *data, size_t len, uint64_t /* now */)
+  {
+    if (len > 0)
+    {
+      pointer = data[0];
+    }
+  }
+
+  size_t requested(uint8_t *data, size_t len, uint64_t /* now */)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      data[i] = registers[(uint8_t)(pointer + i)];
+    }
+
+    return len;
+  }
+};
+
+static bool isHexToken(const std::string &token)
+{
+  if (token.empty() || token.size() % 2 != 0)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < token.size(); i++)
+  {
+    if (!isxdigit((unsigned char)token[i]))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// the bytes of the last complete capture in the file
+static bool readCapture(FILE *in, std::vector<uint8_t> &bytes)
+{
+  char line[1024];
+  bool inCapture = false;
+  bool complete = false;
+  std::vector<uint8_t> current;
+
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    if (strstr(line, "I2C capture end") != NULL)
+    {
+      if (inCapture)
+      {
+        bytes = current;
+        complete = true;
+      }
+      inCapture = false;
+      continue;
+    }
+
+    if (strstr(line, "I2C capture ") != NULL)
+    {
+      inCapture = true;
+      current.clear();
+      continue;
+    }
+
+    if (!inCapture)
+    {
+      continue;
+    }
+
+    // mosquitto_sub -v puts the topic first, the payload is the last token
+    std::string text(line);
+    while (!text.empty() && isspace((unsigned char)text[text.size() - 1]))
+    {
+      text.erase(text.size() - 1);
+    }
+    size_t space = text.find_last_of(" \t");
+    std::string token = space == std::string::npos ? text : text.substr(space + 1);
+
+    if (!isHexToken(token))
+    {
+      continue;
+    }
+
+    for (size_t i = 0; i < token.size(); i += 2)
+    {
+      current.push_back((uint8_t)strtoul(token.substr(i, 2).c_str(), NULL, 16));
+    }
+  }
+
+  return complete;
+}
+
+static bool decode(const std::vector<uint8_t> &bytes, std::vector<Record> &records)
+{
+  size_t i = 0;
+  uint64_t at = 0;
+  bool first = true;
+
+  while (i < bytes.size())
+  {
+    uint32_t delta = 0;
+    int shift = 0;
+
+    while (i < bytes.size() && (bytes[i] & 0x80))
+    {
+      delta |= (uint32_t)(bytes[i++] & 0x7F) << shift;
+      shift += 7;
+    }
+    if (i + 4 > bytes.size())
+    {
+      return false;
+    }
+    delta |= (uint32_t)bytes[i++] << shift;
+
+    // the first delta is relative to a record that is no longer in the ring
+    at = first ? 0 : at + delta;
+    first = false;
+
+    Record record;
+    record.at = at;
+    record.address = bytes[i] >> 1;
+    record.read = bytes[i++] & 1;
+    record.result = bytes[i++];
+    record.len = bytes[i++];
+
+    size_t kept = record.len < I2C_CAPTURE_MAX_DATA ? record.len : I2C_CAPTURE_MAX_DATA;
+    if (i + kept > bytes.size())
+    {
+      return false;
+    }
+    memset(record.data, 0, sizeof(record.data));
+    memcpy(record.data, &bytes[i], kept);
+    i += kept;
+
+    records.push_back(record);
+  }
+
+  return true;
+}
+
+// the recorded compass traffic through QMC5883L::tryRead, one line per sample
+static int replayCompass(const std::vector<Record> &records)
+{
+  CapturedRegisters captured(COMPASS_ADDRESS);
+  QMC5883L sensor;
+  uint32_t samples = 0;
+
+  Wire.attach(captured);
+  sensor.init(); // only writes config, the image answers nothing back
+
+  printf("at_us,x,y,z,status,heading\n");
+
+  for (size_t r = 0; r < records.size(); r++)
+  {
+    const Record &record = records[r];
+
+    if (record.address != COMPASS_ADDRESS || record.result != 0)
+    {
+      continue;
+    }
+
+    size_t kept = record.len < I2C_CAPTURE_MAX_DATA ? record.len : I2C_CAPTURE_MAX_DATA;
+
+    if (record.read == false)
+    {
+      // the register pointer, and any register writes behind it
+      for (size_t i = 0; i < kept; i++)
+      {
+        if (i == 0)
+        {
+          captured.pointer = record.data[0];
+        }
+        else
+        {
+          captured.registers[(uint8_t)(captured.pointer + i - 1)] = record.data[i];
+        }
+      }
+      continue;
+    }
+
+    bool sawStatus = false;
+
+    for (size_t i = 0; i < kept; i++)
+    {
+      uint8_t reg = (uint8_t)(captured.pointer + i);
+      captured.registers[reg] = record.data[i];
+      sawStatus = sawStatus || reg == COMPASS_STATUS;
+    }
+
+    captured.pointer += kept;
+
+    if (sawStatus == false || (captured.registers[COMPASS_STATUS] & QMC5883L_STATUS_DRDY) == 0)
+    {
+      continue;
+    }
+
+    int16_t x, y, z, t;
+    int status = sensor.tryRead(&x, &y, &z, &t);
+
+    if (status == 0)
+    {
+      continue;
+    }
+
+    printf("%llu,%d,%d,%d,%d,%d\n", (unsigned long long)record.at, x, y, z, status, sensor.computeHeading(x, y));
+    samples++;
+
+    // read once, as the chip clears DRDY
+    captured.registers[COMPASS_STATUS] &= ~QMC5883L_STATUS_DRDY;
+  }
+
+  fprintf(stderr, "%u compass samples\n", samples);
+
+  return samples > 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t clock = 100000;
+  const char *path = NULL;
+  bool throughDriver = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc)
+    {
+      clock = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "--compass") == 0)
+    {
+      throughDriver = true;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+
+  FILE *in = path == NULL ? stdin : fopen(path, "r");
+  if (in == NULL)
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+
+  std::vector<uint8_t> bytes;
+  std::vector<Record> records;
+
+  if (!readCapture(in, bytes) || !decode(bytes, records) || records.empty())
+  {
+    fprintf(stderr, "no complete capture found\n");
+    return 1;
+  }
+
+  if (throughDriver == true)
+  {
+    return replayCompass(records);
+  }
+
+  I2CSimBus bus;
+  LolinMotorSim leftMotors(0x09), rightMotors(0x30);
+  QMC5883LSim compass;
+  VL53L0XSim laser;
+  NunchuckSim nunchuck;
+
+  bus.attach(leftMotors);
+  bus.attach(rightMotors);
+  bus.attach(compass);
+  bus.attach(laser);
+  bus.attach(nunchuck);
+  bus.setClock(clock);
+
+  DeviceStats stats[128];
+  memset(stats, 0, sizeof(stats));
+
+  uint64_t lateMicros = 0;
+  uint32_t late = 0;
+
+  for (size_t r = 0; r < records.size(); r++)
+  {
+    const Record &record = records[r];
+
+    if (bus.micros() < record.at)
+    {
+      bus.advance(record.at - bus.micros());
+    }
+    else if (bus.micros() > record.at)
+    {
+      lateMicros += bus.micros() - record.at;
+      late++;
+    }
+
+    uint64_t started = bus.micros();
+    bool ok;
+
+    if (record.read)
+    {
+      ok = bus.requestFrom(record.address, record.len) == record.len;
+      while (bus.available())
+      {
+        bus.read();
+      }
+    }
+    else
+    {
+      bus.beginTransmission(record.address);
+      for (uint8_t i = 0; i < record.len; i++)
+      {
+        bus.write(i < I2C_CAPTURE_MAX_DATA ? record.data[i] : 0);
+      }
+      ok = bus.endTransmission() == 0;
+    }
+
+    DeviceStats &device = stats[record.address & 0x7F];
+    device.transactions++;
+    device.bytes += record.len;
+    device.busMicros += bus.micros() - started;
+    if (ok != (record.result == 0))
+    {
+      device.mismatches++;
+    }
+  }
+
+  uint64_t duration = records.back().at;
+  uint64_t busMicros = 0;
+
+  printf("records %zu over %.3f s, replayed at %u Hz\n", records.size(), duration / 1e6, clock);
+  printf("address transactions bytes bus_us mismatches\n");
+
+  for (int address = 0; address < 128; address++)
+  {
+    if (stats[address].transactions == 0)
+    {
+      continue;
+    }
+
+    printf("0x%02x %u %u %llu %u\n", address, stats[address].transactions, stats[address].bytes,
+           (unsigned long long)stats[address].busMicros, stats[address].mismatches);
+    busMicros += stats[address].busMicros;
+  }
+
+  printf("bus busy %.1f%%, %u transactions started late by %llu us in total\n",
+         duration > 0 ? 100.0 * busMicros / duration : 0.0, late, (unsigned long long)lateMicros);
+
+  return 0;
+}
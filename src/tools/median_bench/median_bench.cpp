@@ -0,0 +1,228 @@
+/*
+   median_bench - cost per call of MedianFilter and MedianHeapFilter
+   (lib/MedianFilter) for a range of window sizes and input shapes, to find
+   where the heap engine overtakes the insertion sort, and of a
+   MedianFilterBank against the same number of separate MedianFilters.
+
+   Build from the project directory:
+     g++ -O2 -std=c++11 -Ilib/MedianFilter tools/median_bench/median_bench.cpp -o median_bench
+
+   Prints CSV, one row per filter, window, input and operation:
+     filter,window,input,op,ns_per_call,checksum
+
+   in is timed over the whole input, out, getMean and getStDev are timed
+   on the window the input left behind. Long windows are given fewer
+   calls so the O(n) cases finish, see WORK. The bank rows time one call
+   of in for all BANK_CHANNELS channels, "MedianFilter*6" the same samples
+   through 6 filters, each channel reading the input from its own offset.
+   The inputs are
+
+     random    uniform in -1000 .. 1000
+     monotonic a ramp, every new sample is the largest
+     constant  the seed value throughout
+     step      0 and 1000 in turns, each held for 1000 samples
+
+   checksum folds in every result so the work can't be optimised away,
+   and should match between runs of the same build. The timings are for
+   the host, the ESP8266 figures in the MedianFilter.h comment are
+   several times higher but scale the same way with the window.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "MedianFilter.h"
+#include "MedianHeapFilter.h"
+#include "MedianFilterBank.h"
+
+#define SAMPLES 8192         // input length, replayed until MAX_CALLS is reached
+#define MAX_CALLS 2000000L   // calls per timed operation
+#define WORK 1000000000L     // calls times window, caps the calls for long windows
+#define BANK_CHANNELS 6      // laser, heading, compass x/y/z and a nunchuck axis
+
+static const char *inputs[] = {"random", "monotonic", "constant", "step"};
+
+static double seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// tells the compiler the filter may have changed, so reads aren't hoisted
+template <typename F>
+static inline void clobber(F &filter)
+{
+  asm volatile("" : : "r"(&filter) : "memory");
+}
+
+static void makeInput(const char *input, std::vector<int> &samples)
+{
+  samples.resize(SAMPLES);
+  srand(1);
+
+  for (int i = 0; i < SAMPLES; i++)
+  {
+    if (strcmp(input, "random") == 0)
+    {
+      samples[i] = rand() % 2001 - 1000;
+    }
+    else if (strcmp(input, "monotonic") == 0)
+    {
+      samples[i] = i;
+    }
+    else if (strcmp(input, "constant") == 0)
+    {
+      samples[i] = 0;
+    }
+    else
+    {
+      samples[i] = (i / 1000) % 2 == 0 ? 0 : 1000;
+    }
+  }
+}
+
+static void row(const char *filter, size_t window, const char *input, const char *op, double ns, long checksum)
+{
+  printf("%s,%zu,%s,%s,%.2f,%ld\n", filter, window, input, op, ns, checksum);
+}
+
+template <typename F, size_t N>
+static void bench(const char *name, const char *input, const std::vector<int> &samples)
+{
+  const long calls = MAX_CALLS < WORK / (long)N ? MAX_CALLS : WORK / (long)N;
+  const long rounds = calls > SAMPLES ? calls / SAMPLES : 1;
+  F filter(0);
+  long checksum = 0;
+
+  // the monotonic ramp starts again each round, so every round sees the
+  // same drop back to 0 at its start
+  double started = seconds();
+  for (long r = 0; r < rounds; r++)
+  {
+    for (int i = 0; i < SAMPLES; i++)
+    {
+      checksum += filter.in(samples[i]);
+    }
+  }
+  row(name, N, input, "in", (seconds() - started) * 1e9 / (rounds * SAMPLES), checksum);
+
+  struct
+  {
+    const char *name;
+    int (F::*call)();
+  } ops[] = {
+      {"out", &F::out},
+      {"getMean", &F::getMean},
+      {"getStDev", &F::getStDev},
+  };
+
+  for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++)
+  {
+    checksum = 0;
+    started = seconds();
+    for (long i = 0; i < calls; i++)
+    {
+      clobber(filter);
+      checksum += (filter.*ops[o].call)();
+    }
+    row(name, N, input, ops[o].name, (seconds() - started) * 1e9 / calls, checksum);
+  }
+}
+
+template <size_t N>
+static void benchBoth(const char *input, const std::vector<int> &samples)
+{
+  bench<MedianFilter<int, N>, N>("MedianFilter", input, samples);
+  bench<MedianHeapFilter<int, N>, N>("MedianHeapFilter", input, samples);
+}
+
+template <size_t N>
+static void benchBank(const char *input, const std::vector<int> &samples)
+{
+  const size_t K = BANK_CHANNELS;
+  const long rounds = MAX_CALLS / K / SAMPLES + 1;
+  MedianFilterBank<int, K, N> bank(0);
+  MedianFilter<int, N> filters[K];
+  int batch[K];
+  long checksum = 0;
+
+  double started = seconds();
+  for (long r = 0; r < rounds; r++)
+  {
+    for (int i = 0; i < SAMPLES; i++)
+    {
+      for (size_t c = 0; c < K; c++)
+      {
+        batch[c] = samples[(i + c * 1000) % SAMPLES];
+      }
+
+      const int *medians = bank.in(batch);
+      for (size_t c = 0; c < K; c++)
+      {
+        checksum += medians[c];
+      }
+    }
+  }
+  row("MedianFilterBank6", N, input, "in", (seconds() - started) * 1e9 / (rounds * SAMPLES), checksum);
+
+  checksum = 0;
+  started = seconds();
+  for (long r = 0; r < rounds; r++)
+  {
+    for (int i = 0; i < SAMPLES; i++)
+    {
+      for (size_t c = 0; c < K; c++)
+      {
+        batch[c] = samples[(i + c * 1000) % SAMPLES];
+      }
+
+      for (size_t c = 0; c < K; c++)
+      {
+        checksum += filters[c].in(batch[c]);
+      }
+    }
+  }
+  row("MedianFilter*6", N, input, "in", (seconds() - started) * 1e9 / (rounds * SAMPLES), checksum);
+}
+
+int main()
+{
+  printf("filter,window,input,op,ns_per_call,checksum\n");
+
+  std::vector<int> samples;
+
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+  {
+    makeInput(inputs[i], samples);
+
+    benchBoth<3>(inputs[i], samples);
+    benchBoth<5>(inputs[i], samples);
+    benchBoth<7>(inputs[i], samples);
+    benchBoth<9>(inputs[i], samples);
+    benchBoth<11>(inputs[i], samples);
+    benchBoth<15>(inputs[i], samples);
+    benchBoth<21>(inputs[i], samples);
+    benchBoth<31>(inputs[i], samples);
+    benchBoth<63>(inputs[i], samples);
+    benchBoth<127>(inputs[i], samples);
+    benchBoth<255>(inputs[i], samples);
+    benchBoth<511>(inputs[i], samples);
+    benchBoth<1023>(inputs[i], samples);
+    benchBoth<4095>(inputs[i], samples);
+  }
+
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+  {
+    makeInput(inputs[i], samples);
+
+    benchBank<7>(inputs[i], samples);
+    benchBank<15>(inputs[i], samples);
+    benchBank<31>(inputs[i], samples);
+  }
+
+  return 0;
+}
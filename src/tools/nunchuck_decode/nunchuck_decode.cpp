@@ -0,0 +1,166 @@
+/*
+   nunchuck_decode - checks decodeNunchuckReport (src/nunchuckReport.cpp)
+   against the NunchuckSim device model, and decodes recorded reports.
+
+   Build from the project directory:
+     g++ -O2 -std=c++11 -Iinclude -Ilib/I2CSim tools/nunchuck_decode/nunchuck_decode.cpp src/nunchuckReport.cpp lib/I2CSim/I2CSim.cpp -o nunchuck_decode
+
+   Run with no arguments to check every joystick value, every 10 bit
+   accelerometer value on each axis and every button combination through
+   a simulated bus read, printing one "name value" line per result. The
+   sim encodes with the same reading of the layout the decoder has, so this
+   only catches the two drifting apart; test/test_nunchuck_report checks
+   the decoder against fixed reports with known values.
+
+   Run with a file of recorded reports, one per line as the 12 hex digits
+   read off the bus (an I2C capture of address 0x52 has them), to print
+   them decoded as CSV: joy_x,joy_y,accel_x,accel_y,accel_z,z,c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "I2CSim.h"
+#include "nunchuckReport.h"
+
+// as Nunchuck::nunchuk_decode_byte
+static uint8_t decodeByte(uint8_t x)
+{
+  return (x ^ 0x17) + 0x17;
+}
+
+// the read Nunchuck::nunchuck_get_data does, then the decode
+static NunchuckReport readReport(I2CSimBus &bus, NunchuckSim &nunchuck)
+{
+  uint8_t buf[6];
+
+  // the sim samples its fields on the conversion request
+  bus.beginTransmission(nunchuck.address);
+  bus.write(0x00);
+  bus.endTransmission();
+
+  bus.requestFrom(nunchuck.address, 6);
+  for (int i = 0; i < 6; i++)
+  {
+    buf[i] = decodeByte(bus.read());
+  }
+
+  return decodeNunchuckReport(buf);
+}
+
+static bool matches(const NunchuckReport &report, const NunchuckSim &nunchuck)
+{
+  return report.joyX == nunchuck.joyX && report.joyY == nunchuck.joyY &&
+         report.accelX == nunchuck.accelX && report.accelY == nunchuck.accelY && report.accelZ == nunchuck.accelZ &&
+         report.zButton == nunchuck.zButton && report.cButton == nunchuck.cButton;
+}
+
+static int selfCheck()
+{
+  I2CSimBus bus;
+  NunchuckSim nunchuck;
+  bus.attach(nunchuck);
+
+  bus.beginTransmission(nunchuck.address);
+  bus.write(0x40);
+  bus.write(0x00);
+  bus.endTransmission();
+
+  uint32_t checked = 0;
+  uint32_t mismatches = 0;
+
+  for (int value = 0; value < 1024; value++)
+  {
+    for (int buttons = 0; buttons < 4; buttons++)
+    {
+      // each axis takes the value in turn, the others a different one so
+      // swapped bits would show
+      for (int axis = 0; axis < 3; axis++)
+      {
+        nunchuck.accelX = axis == 0 ? value : 1023 - value;
+        nunchuck.accelY = axis == 1 ? value : (value * 7) & 1023;
+        nunchuck.accelZ = axis == 2 ? value : (value * 13 + 5) & 1023;
+        nunchuck.joyX = value & 0xFF;
+        nunchuck.joyY = (value >> 2) ^ 0xA5;
+        nunchuck.zButton = buttons & 1;
+        nunchuck.cButton = (buttons >> 1) & 1;
+
+        if (!matches(readReport(bus, nunchuck), nunchuck))
+        {
+          if (mismatches == 0)
+          {
+            printf("first_mismatch accel %d,%d,%d buttons %d\n", nunchuck.accelX, nunchuck.accelY, nunchuck.accelZ, buttons);
+          }
+          mismatches++;
+        }
+        checked++;
+      }
+    }
+  }
+
+  NunchuckReport idle = idleNunchuckReport();
+
+  printf("reports_checked %u\n", checked);
+  printf("mismatches %u\n", mismatches);
+  printf("report_bytes %zu\n", sizeof(NunchuckReport));
+  printf("idle %d,%d %d,%d,%d %d,%d\n", idle.joyX, idle.joyY, idle.accelX, idle.accelY, idle.accelZ, idle.zButton, idle.cButton);
+
+  return mismatches == 0 ? 0 : 1;
+}
+
+static int decodeFile(const char *path)
+{
+  FILE *in = fopen(path, "r");
+  if (in == NULL)
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+
+  char line[256];
+  printf("joy_x,joy_y,accel_x,accel_y,accel_z,z,c\n");
+
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    uint8_t buf[6];
+    int digits = 0;
+    char pair[3] = {0, 0, 0};
+
+    for (char *c = line; *c != 0 && digits < 12; c++)
+    {
+      if (!isxdigit((unsigned char)*c))
+      {
+        continue;
+      }
+
+      pair[digits % 2] = *c;
+      if (digits % 2 == 1)
+      {
+        buf[digits / 2] = decodeByte((uint8_t)strtoul(pair, NULL, 16));
+      }
+      digits++;
+    }
+
+    if (digits < 12)
+    {
+      continue;
+    }
+
+    NunchuckReport report = decodeNunchuckReport(buf);
+    printf("%d,%d,%d,%d,%d,%d,%d\n", report.joyX, report.joyY, report.accelX, report.accelY, report.accelZ, report.zButton, report.cButton);
+  }
+
+  fclose(in);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+  {
+    return decodeFile(argv[1]);
+  }
+
+  return selfCheck();
+}
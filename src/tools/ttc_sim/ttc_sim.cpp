@@ -0,0 +1,192 @@
+/*
+   ttc_sim - stopping distance against control loop period, for the
+   distance-scaled duty in Motors::setMapped with and without the time to
+   collision brake from Motors::checkCollision.
+
+   Build from the project directory:
+     g++ -O2 -std=c++11 -Iinclude -Ilib/MedianFilter tools/ttc_sim/ttc_sim.cpp src/rangeRate.cpp src/leastSquares.cpp -o ttc_sim
+
+   Prints CSV: strategy,loop_ms,top_speed_mm_s,worst_gap_mm,mean_gap_mm,collisions
+
+   Where the loop ticks fall against the approach decides how much of a
+   period passes between the TTC crossing the threshold and the loop
+   seeing it, so every phase of the loop against the start is run and the
+   worst and mean final gaps reported, with the number of phases that hit
+   the wall.
+
+   The car starts 1500mm from a wall at full duty. Speed follows duty with a
+   first order lag, short brake and coasting decelerate at fixed rates. The
+   laser delivers a sample with a few mm of noise, and now and then a far
+   spike, every timing budget. Samples go through the laser's HampelFilter,
+   which replaces the spikes and passes closer readings as they are. The
+   loop only sees the newest one at each tick and, as Motors::checkCollision,
+   adds it to the range rate fit once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "rangeRate.h"
+#include "HampelFilter.h"
+
+#define TTC_BRAKE_MS 400 // as include/motors.h
+
+// as include/laser.h
+#define LASER_HAMPEL_WINDOW 7
+#define LASER_HAMPEL_THRESHOLD 30
+#define LASER_HAMPEL_MIN_MAD 10
+
+static const double startGapMM = 1500;
+static const double motorLagMS = 150;
+static const double brakeDecel = 4000; // mm/s^2
+static const double coastDecel = 800;  // mm/s^2
+static const int laserBudgetMS = 33;
+static const int commandLatencyMS = 1; // I2C write of one command
+
+// Motors::setMapped with the laser range, driving NORTH
+static int scaledDuty(int rangeMM)
+{
+  const int maxDuty = 50, SafeDistanceMM = 300, DeadzoneMM = 60, minimumDuty = 16;
+
+  if (rangeMM > SafeDistanceMM)
+  {
+    return maxDuty;
+  }
+  if (rangeMM >= DeadzoneMM)
+  {
+    return minimumDuty + (rangeMM - DeadzoneMM) * (maxDuty - minimumDuty) / (SafeDistanceMM - DeadzoneMM);
+  }
+  return 0;
+}
+
+static double run(bool ttc, int loopMS, int phaseMS, double topSpeed, bool *collided)
+{
+  RangeRate rangeRate;
+  HampelFilter<int, LASER_HAMPEL_WINDOW> outliers(LASER_HAMPEL_THRESHOLD, LASER_HAMPEL_MIN_MAD, true);
+  double gap = startGapMM, speed = topSpeed;
+  double targetSpeed = topSpeed;
+  bool braking = false, pendingBrake = false;
+  int pendingDuty = 50, pendingAt = -1, brakeAt = -1;
+  int laserRange = INT_MAX;
+  unsigned long laserAt = 0;
+  uint32_t laserSequence = 0, fittedSequence = 0;
+  uint32_t noise = 12345;
+
+  *collided = false;
+
+  for (int t = 0; t < 10000; t++)
+  {
+    // physics, 1ms step
+    if (braking)
+    {
+      speed -= brakeDecel / 1000;
+    }
+    else if (targetSpeed < speed)
+    {
+      double lagged = speed + (targetSpeed - speed) / motorLagMS;
+      speed = targetSpeed == 0 && speed - coastDecel / 1000 > lagged ? speed - coastDecel / 1000 : lagged;
+    }
+    else
+    {
+      speed += (targetSpeed - speed) / motorLagMS;
+    }
+    if (speed < 0)
+    {
+      speed = 0;
+    }
+    gap -= speed / 1000;
+
+    if (gap <= 0)
+    {
+      *collided = true;
+      return 0;
+    }
+
+    if (speed == 0 && (braking || targetSpeed == 0))
+    {
+      return gap;
+    }
+
+    // laser, a new sample at the end of every timing budget
+    if (t % laserBudgetMS == 0)
+    {
+      noise = noise * 1103515245 + 12345;
+      laserRange = (int)gap + (int)((noise >> 16) % 9) - 4;
+      if ((noise >> 8) % 20 == 0)
+      {
+        laserRange += 1000; // the beam missed, as off a dark or glancing surface
+      }
+      laserRange = outliers.in(laserRange);
+      laserAt = t * 1000UL;
+      laserSequence++;
+    }
+
+    // commands reach the motors after the I2C write
+    if (pendingAt == t)
+    {
+      targetSpeed = topSpeed * pendingDuty / 50;
+    }
+    if (brakeAt == t)
+    {
+      braking = true;
+    }
+
+    // control loop tick
+    if ((t + phaseMS) % loopMS == 0)
+    {
+      if (laserSequence != fittedSequence)
+      {
+        fittedSequence = laserSequence;
+        rangeRate.add(laserRange, laserAt);
+      }
+
+      if (ttc && !pendingBrake && rangeRate.ttcMillis() < TTC_BRAKE_MS)
+      {
+        pendingBrake = true;
+        brakeAt = t + commandLatencyMS;
+      }
+
+      if (!pendingBrake)
+      {
+        pendingDuty = scaledDuty(laserRange);
+        pendingAt = t + commandLatencyMS;
+      }
+    }
+  }
+
+  return gap;
+}
+
+int main()
+{
+  static const int loops[] = {10, 20, 50, 100, 200, 300};
+  static const double speeds[] = {300, 600, 900, 1200};
+
+  printf("strategy,loop_ms,top_speed_mm_s,worst_gap_mm,mean_gap_mm,collisions\n");
+
+  for (int strategy = 0; strategy < 2; strategy++)
+  {
+    for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++)
+    {
+      for (size_t l = 0; l < sizeof(loops) / sizeof(loops[0]); l++)
+      {
+        double worst = startGapMM, sum = 0;
+        int collisions = 0;
+
+        for (int phase = 0; phase < loops[l]; phase++)
+        {
+          bool collided;
+          double gap = run(strategy == 1, loops[l], phase, speeds[s], &collided);
+
+          worst = gap < worst ? gap : worst;
+          sum += gap;
+          collisions += collided ? 1 : 0;
+        }
+
+        printf("%s,%d,%.0f,%.0f,%.0f,%d\n", strategy == 1 ? "ttc" : "distance", loops[l], speeds[s], worst, sum / loops[l], collisions);
+      }
+    }
+  }
+
+  return 0;
+}